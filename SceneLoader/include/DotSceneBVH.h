@@ -0,0 +1,63 @@
+#ifndef DOT_SCENEBVH_H
+#define DOT_SCENEBVH_H
+
+// Includes
+#include <OgreAxisAlignedBox.h>
+#include <OgreRay.h>
+
+#include <vector>
+
+// Forward declarations
+namespace Ogre
+{
+class Entity;
+} // namespace Ogre
+
+/** Flat bounding volume hierarchy over the entities of a loaded scene
+
+    The world bounds are captured at load time, so it can be queried without touching the SceneManager.
+    It does not follow entities that are moved or destroyed afterwards.
+*/
+class DotSceneBVH
+{
+public:
+    struct Item
+    {
+        Ogre::AxisAlignedBox bounds;
+        Ogre::Entity* entity;
+    };
+
+    /// add an entity with its world bounds, call build() once all are added
+    void add(const Ogre::AxisAlignedBox& bounds, Ogre::Entity* entity);
+    void build();
+    void clear();
+
+    bool empty() const { return mNodes.empty(); }
+
+    /// bounds of everything in the hierarchy
+    const Ogre::AxisAlignedBox& getBounds() const;
+
+    /// entities whose bounds intersect box
+    void query(const Ogre::AxisAlignedBox& box, std::vector<Ogre::Entity*>& result) const;
+    /// entities whose bounds are hit by ray
+    void query(const Ogre::Ray& ray, std::vector<Ogre::Entity*>& result) const;
+
+private:
+    struct Node
+    {
+        Ogre::AxisAlignedBox bounds;
+        /// items of a leaf
+        Ogre::uint32 first, count;
+        /// second child of an inner node, the first one directly follows it
+        Ogre::uint32 right;
+    };
+
+    Ogre::uint32 buildNode(Ogre::uint32 first, Ogre::uint32 count);
+
+    template <typename Test> void traverse(const Test& test, std::vector<Ogre::Entity*>& result) const;
+
+    std::vector<Item> mItems;
+    std::vector<Node> mNodes;
+};
+
+#endif // DOT_SCENEBVH_H
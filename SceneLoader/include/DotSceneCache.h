@@ -0,0 +1,36 @@
+#ifndef DOT_SCENECACHE_H
+#define DOT_SCENECACHE_H
+
+// Includes
+#include "DotSceneData.h"
+
+#include <OgrePlatform.h>
+#include <OgreString.h>
+
+/** On-disk cache of parsed scenes
+
+    Entries are keyed by a hash of the source stream and FORMAT_VERSION, so editing a scene or updating the
+    loader makes the old entry unreachable. Entries that can not be read are treated as misses.
+*/
+class DotSceneCache
+{
+public:
+    /// bump whenever DotSceneData or the way it is parsed changes
+    static const Ogre::uint32 FORMAT_VERSION;
+
+    explicit DotSceneCache(const Ogre::String& directory);
+
+    /// key of a source stream of size bytes
+    static Ogre::uint64 computeKey(const void* source, size_t size);
+
+    /// false if there is no usable entry for key, data is left untouched then
+    bool load(Ogre::uint64 key, DotSceneData& data) const;
+    bool save(Ogre::uint64 key, const DotSceneData& data) const;
+
+private:
+    Ogre::String getPath(Ogre::uint64 key) const;
+
+    Ogre::String mDirectory;
+};
+
+#endif // DOT_SCENECACHE_H
@@ -0,0 +1,234 @@
+#ifndef DOT_SCENEDATA_H
+#define DOT_SCENEDATA_H
+
+// Includes
+#include <OgreColourValue.h>
+#include <OgreCommon.h>
+#include <OgreNode.h>
+#include <OgreQuaternion.h>
+#include <OgreString.h>
+#include <OgreVector3.h>
+
+#include <vector>
+
+/** Parsed and resolved form of a .scene file
+
+    DotSceneLoader parses the XML into this and instantiates the scene from it, so it is also what the load
+    cache stores. Nodes are flattened in pre-order, i.e. a parent always precedes its children. All references
+    to nodes are indices into nodes, NO_NODE standing for the attach node.
+*/
+struct DotSceneData
+{
+    static const int NO_NODE = -1;
+
+    struct Property
+    {
+        Ogre::String name;
+        Ogre::String type;
+        Ogre::String data;
+    };
+
+    /// range in properties
+    struct UserData
+    {
+        Ogre::uint32 first;
+        Ogre::uint32 count;
+
+        UserData() : first(0), count(0) {}
+    };
+
+    struct Node
+    {
+        /// as written in the file, without the name prefix of the load
+        Ogre::String name;
+        int parent;
+        Ogre::Vector3 position;
+        Ogre::Quaternion orientation;
+        Ogre::Vector3 scale;
+        UserData userData;
+    };
+
+    struct LookTarget
+    {
+        int node;
+        /// resolved target node, NO_NODE if not part of this scene
+        int target;
+        /// the unresolved target name, empty for a fixed position
+        Ogre::String targetName;
+        Ogre::Node::TransformSpace relativeTo;
+        Ogre::Vector3 position;
+        Ogre::Vector3 localDirection;
+    };
+
+    struct TrackTarget
+    {
+        int node;
+        /// resolved target node, NO_NODE if not part of this scene
+        int target;
+        Ogre::String targetName;
+        Ogre::Vector3 localDirection;
+        Ogre::Vector3 offset;
+    };
+
+    struct Entity
+    {
+        int node;
+        Ogre::String name;
+        /// index into meshes
+        Ogre::uint32 mesh;
+        Ogre::String material;
+        bool castShadows;
+        UserData userData;
+    };
+
+    struct Light
+    {
+        /// NO_NODE for a light that is not attached
+        int node;
+        Ogre::String name;
+        Ogre::String type;
+        bool visible;
+        /// 1 or 0 if castShadows is given, -1 otherwise
+        int castShadows;
+        Ogre::Real powerScale;
+        bool hasDiffuse;
+        Ogre::ColourValue diffuse;
+        bool hasSpecular;
+        Ogre::ColourValue specular;
+        bool hasRange;
+        /// spotlight angles in radians
+        Ogre::Real inner, outer, falloff;
+        bool hasAttenuation;
+        Ogre::Real range, constant, linear, quadratic;
+        UserData userData;
+    };
+
+    struct Camera
+    {
+        /// NO_NODE if the camera gets a node of its own
+        int node;
+        Ogre::String name;
+        Ogre::Real aspectRatio;
+        Ogre::String projectionType;
+        bool hasClipping;
+        Ogre::Real nearDist, farDist;
+        UserData userData;
+    };
+
+    struct ParticleSystem
+    {
+        int node;
+        Ogre::String name;
+        Ogre::String templateName;
+        /// 0 keeps the quota of the template
+        Ogre::uint32 quota;
+    };
+
+    struct Plane
+    {
+        int node;
+        Ogre::String name;
+        Ogre::Real distance, width, height;
+        int xSegments, ySegments, numTexCoordSets;
+        Ogre::Real uTile, vTile;
+        Ogre::String material;
+        bool hasNormals;
+        Ogre::Vector3 normal, up;
+        /// the <plane> element, kept for DotSceneExporter
+        Ogre::String definition;
+    };
+
+    struct Fog
+    {
+        Ogre::FogMode mode;
+        Ogre::ColourValue colour;
+        Ogre::Real density, start, end;
+    };
+
+    struct SkyBox
+    {
+        Ogre::String material;
+        Ogre::Real distance;
+        bool drawFirst;
+        Ogre::Quaternion rotation;
+    };
+
+    struct SkyDome
+    {
+        Ogre::String material;
+        Ogre::Real curvature, tiling, distance;
+        bool drawFirst;
+        Ogre::Quaternion rotation;
+    };
+
+    struct SkyPlane
+    {
+        Ogre::String material;
+        Ogre::Vector3 normal;
+        Ogre::Real d, scale, bow, tiling;
+        bool drawFirst;
+    };
+
+    struct Environment
+    {
+        bool hasFog, hasSkyBox, hasSkyDome, hasSkyPlane, hasAmbient, hasBackground;
+        Fog fog;
+        SkyBox skyBox;
+        SkyDome skyDome;
+        SkyPlane skyPlane;
+        Ogre::ColourValue ambient;
+        Ogre::ColourValue background;
+
+        Environment()
+            : hasFog(false), hasSkyBox(false), hasSkyDome(false), hasSkyPlane(false), hasAmbient(false),
+              hasBackground(false)
+        {
+        }
+    };
+
+    struct TerrainPage
+    {
+        int x, y;
+        Ogre::String dataFile;
+    };
+
+    struct TerrainGroup
+    {
+        Ogre::Real worldSize;
+        int mapSize;
+        int compositeMapDistance;
+        int maxPixelError;
+        std::vector<TerrainPage> pages;
+    };
+
+    /// transform of the attach node, only applied where given
+    bool hasRootPosition, hasRootOrientation, hasRootScale;
+    Ogre::Vector3 rootPosition;
+    Ogre::Quaternion rootOrientation;
+    Ogre::Vector3 rootScale;
+
+    Environment environment;
+
+    std::vector<Node> nodes;
+    std::vector<LookTarget> lookTargets;
+    std::vector<TrackTarget> trackTargets;
+    std::vector<Entity> entities;
+    std::vector<Light> lights;
+    std::vector<Camera> cameras;
+    std::vector<ParticleSystem> particleSystems;
+    std::vector<Plane> planes;
+
+    std::vector<Property> properties;
+    /// userData of the scene, applied to the attach node
+    UserData userData;
+
+    /// every mesh the scene references, once
+    Ogre::StringVector meshes;
+
+    bool hasTerrainGroup;
+    TerrainGroup terrainGroup;
+
+    DotSceneData() : hasRootPosition(false), hasRootOrientation(false), hasRootScale(false), hasTerrainGroup(false) {}
+};
+
+#endif // DOT_SCENEDATA_H
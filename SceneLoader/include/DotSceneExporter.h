@@ -0,0 +1,70 @@
+#ifndef DOT_SCENEEXPORTER_H
+#define DOT_SCENEEXPORTER_H
+
+// Includes
+#include <OgreColourValue.h>
+#include <OgreString.h>
+#include <OgreStringVector.h>
+
+#include <iosfwd>
+
+// Forward declarations
+namespace Ogre
+{
+class Camera;
+class Entity;
+class Light;
+class SceneManager;
+class SceneNode;
+class UserObjectBindings;
+} // namespace Ogre
+
+class XMLStreamWriter;
+
+/** Writes a SceneNode subtree to the .scene format
+
+    The output is streamed while the graph is walked, so no intermediate DOM is built.
+    Everything written can be read back by DotSceneLoader and validates against dotscene.dtd.
+
+    Sky boxes, domes and planes are not exported, as the SceneManager does not expose their material
+    and parameters. Particle systems and track targets are not exported either.
+*/
+class DotSceneExporter
+{
+public:
+    DotSceneExporter();
+
+    void exportScene(Ogre::SceneNode* rootNode, const Ogre::String& outFileName);
+    void exportScene(Ogre::SceneNode* rootNode, std::ostream& out);
+
+    /// serialize the children of the root node on worker threads
+    void setParallel(bool parallel) { mParallel = parallel; }
+    bool getParallel() const { return mParallel; }
+
+    /** UserObjectBindings can not be enumerated, so only the listed keys are written as userData
+        values of type bool, Real, int and String are supported
+    */
+    void setUserDataKeys(const Ogre::StringVector& keys) { mUserDataKeys = keys; }
+
+    /// the background colour is not part of the SceneManager state, so it has to be provided
+    void setBackgroundColour(const Ogre::ColourValue& colour)
+    {
+        mBackgroundColour = colour;
+        mHasBackgroundColour = true;
+    }
+
+protected:
+    void writeEnvironment(XMLStreamWriter& writer, Ogre::SceneManager* sceneMgr);
+    void writeNode(XMLStreamWriter& writer, const Ogre::SceneNode* node);
+    void writeEntity(XMLStreamWriter& writer, const Ogre::Entity* entity);
+    void writeLight(XMLStreamWriter& writer, const Ogre::Light* light);
+    void writeCamera(XMLStreamWriter& writer, const Ogre::Camera* camera);
+    void writeUserData(XMLStreamWriter& writer, const Ogre::UserObjectBindings& userData);
+
+    bool mParallel;
+    bool mHasBackgroundColour;
+    Ogre::ColourValue mBackgroundColour;
+    Ogre::StringVector mUserDataKeys;
+};
+
+#endif // DOT_SCENEEXPORTER_H
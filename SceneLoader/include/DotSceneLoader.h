@@ -2,11 +2,21 @@
 #define DOT_SCENELOADER_H
 
 // Includes
+#include "DotSceneBVH.h"
+#include "DotSceneData.h"
+#include "DotScenePlaceholder.h"
+
 #include <OgreColourValue.h>
 #include <OgreQuaternion.h>
 #include <OgreResourceGroupManager.h>
 #include <OgreSceneLoader.h>
+#include <OgreSceneManager.h>
 #include <OgreString.h>
+#include <OgreVector3.h>
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 
 // Forward declarations
 namespace Ogre
@@ -21,56 +31,344 @@ namespace pugi
 class xml_node;
 }
 
-class DotSceneLoader : public Ogre::SceneLoader
+/** Loads .scene files
+
+    Loads into different SceneManagers may run concurrently on several threads. Ogre must be built with
+    thread support then, as the resource managers are shared.
+*/
+class DotSceneLoader : public Ogre::SceneLoader,
+                       public Ogre::SceneManager::Listener,
+                       public DotScenePlaceholder::Listener
 {
 public:
+    enum BudgetPolicy
+    {
+        /** entities that do not fit into the budget are skipped and reported by getDeferredEntities.
+            Entities are created in file order, or by priority if setBudgetPriorityKey is set */
+        BP_DEFER,
+        /** nothing is loaded if the estimated cost of the scene exceeds the budget.
+            The estimate only covers meshes and terrain, so entities can still end up deferred */
+        BP_FAIL
+    };
+
+    /// bytes referenced by a load
+    struct MemoryUsage
+    {
+        /// resources that became resident because of this load
+        size_t unique;
+        /// resources that were already resident
+        size_t shared;
+
+        MemoryUsage() : unique(0), shared(0) {}
+    };
+
+    /// memory referenced by the last load, per resource type
+    struct MemoryReport
+    {
+        MemoryUsage meshes;
+        MemoryUsage materials;
+        MemoryUsage textures;
+        MemoryUsage terrain;
+
+        size_t getUnique() const { return meshes.unique + materials.unique + textures.unique + terrain.unique; }
+        size_t getShared() const { return meshes.shared + materials.shared + textures.shared + terrain.shared; }
+    };
+
+    /// an <entity> that was not created because of the memory budget
+    struct DeferredEntity
+    {
+        Ogre::String name;
+        Ogre::String meshFile;
+        Ogre::String material;
+        bool castShadows;
+        Ogre::SceneNode* parent;
+    };
+
+    enum LightImportMode
+    {
+        /// every <light> becomes a Light
+        LIM_INDIVIDUAL,
+        /** point and spot lights are collected by getPackedLights instead.
+            Only lights with castShadows="true" and directional lights become Lights, and only
+            the explicitly flagged ones cast shadows */
+        LIM_PACKED
+    };
+
+    /// light record laid out as six float4 rows, so an array of them can be uploaded to a texture buffer
+    struct PackedLight
+    {
+        /// world space position, w: Light::LightTypes
+        float position[4];
+        /// world space direction, w: attenuation range
+        float direction[4];
+        /// diffuse colour, w: power scale
+        float diffuse[4];
+        /// specular colour, w: 1 if visible
+        float specular[4];
+        /// constant, linear and quadratic attenuation
+        float attenuation[4];
+        /// cosine of the half inner and outer spotlight angles, falloff
+        float spot[4];
+    };
+
+    /// outcome of a load
+    struct LoadResult
+    {
+        Ogre::TerrainGroup* terrainGroup;
+        Ogre::ColourValue backgroundColour;
+        MemoryReport memoryReport;
+        std::vector<DeferredEntity> deferredEntities;
+        /// point and spot lights in LIM_PACKED mode
+        std::vector<PackedLight> packedLights;
+        /// world bounds of the entities, planes and terrain
+        Ogre::AxisAlignedBox bounds;
+        /// entities by world bounds, only filled if enabled by setBuildBVH. Placeholders are not included
+        DotSceneBVH bvh;
+        /// named nodes by their name in the file, only filled if enabled by setUnnamedNodes
+        std::unordered_map<Ogre::String, Ogre::SceneNode*> nodes;
+
+        LoadResult() : terrainGroup(0), backgroundColour(Ogre::ColourValue::Black) {}
+    };
+
+    /** restricts a load to part of the scene, by default everything is loaded
+
+        Elements left out are skipped while parsing, so their resources are never loaded. Nodes left out
+        pass their transform on to their child nodes, which are still considered.
+    */
+    struct LoadFilter
+    {
+        enum ElementType
+        {
+            ET_ENTITY = 1 << 0,
+            ET_LIGHT = 1 << 1,
+            ET_CAMERA = 1 << 2,
+            ET_PARTICLE_SYSTEM = 1 << 3,
+            ET_PLANE = 1 << 4,
+            ET_INSTANCES = 1 << 5,
+            ET_ENVIRONMENT = 1 << 6,
+            ET_TERRAIN = 1 << 7,
+            ET_ALL = 0xFFFF
+        };
+
+        /// ElementType flags of the elements to load
+        Ogre::uint32 elements;
+        /** only the nodes named here are loaded, along with the nodes below them. Empty for all nodes.
+            The <light> and <camera> directly below <scene> are left out as well then */
+        Ogre::StringVector subtreeRoots;
+        /** a node is loaded if this accepts its name, unset to accept all
+            The nodes of <instances> have no name and no userData, they are loaded if a node like that is */
+        std::function<bool(const Ogre::String& name)> nodeName;
+        /// a node is loaded if this accepts the properties of its <userData>, by name, unset to accept all
+        std::function<bool(const Ogre::NameValuePairList& userData)> nodeUserData;
+
+        LoadFilter() : elements(ET_ALL) {}
+
+        bool isEmpty() const { return elements == ET_ALL && subtreeRoots.empty() && !nodeName && !nodeUserData; }
+    };
+
     DotSceneLoader();
     virtual ~DotSceneLoader();
 
     void load(Ogre::DataStreamPtr& stream, const Ogre::String& groupName, Ogre::SceneNode* rootNode);
 
+    /// load the part of the scene passing filter. Filtered loads bypass the scene cache
+    void load(Ogre::DataStreamPtr& stream, const Ogre::String& groupName, Ogre::SceneNode* rootNode,
+              const LoadFilter& filter);
+
     void parseDotScene(const Ogre::String& SceneName, const Ogre::String& groupName, Ogre::SceneNode* pAttachNode,
-                       const Ogre::String& sPrependNode = "");
+                       const Ogre::String& sPrependNode = "", const LoadFilter& filter = LoadFilter());
+
+    /// copy of the result of the last load into sceneMgr. A reference could be overwritten by a concurrent load
+    /// into the same SceneManager. The objects it points to stay valid until the SceneManager is destroyed
+    LoadResult getResult(Ogre::SceneManager* sceneMgr) const;
+
+    /// @name Results of the most recent load
+    /// Only meaningful if loads do not run concurrently, use getResult otherwise. The references are overwritten
+    /// by the next load into the same SceneManager
+    /// @{
+    Ogre::TerrainGroup* getTerrainGroup() { return mLastResult->terrainGroup; }
+
+    const Ogre::ColourValue& getBackgroundColour() { return mLastResult->backgroundColour; }
+
+    const MemoryReport& getMemoryReport() const { return mLastResult->memoryReport; }
+
+    const std::vector<DeferredEntity>& getDeferredEntities() const { return mLastResult->deferredEntities; }
+
+    const std::vector<PackedLight>& getPackedLights() const { return mLastResult->packedLights; }
 
-    Ogre::TerrainGroup* getTerrainGroup() { return mTerrainGroup; }
+    const Ogre::AxisAlignedBox& getSceneBounds() const { return mLastResult->bounds; }
+    /// @}
 
-    const Ogre::ColourValue& getBackgroundColour() { return mBackgroundColour; }
+    /// @name Settings
+    /// They are picked up when a load starts
+    /// @{
+    /** limit the memory a load may make resident
+        @param bytes budget for the unique resources of a load, 0 disables the budget
+        @param policy what to do if the budget is exceeded
+    */
+    void setMemoryBudget(size_t bytes, BudgetPolicy policy = BP_DEFER)
+    {
+        mMemoryBudget = bytes;
+        mBudgetPolicy = policy;
+    }
+    size_t getMemoryBudget() const { return mMemoryBudget; }
+
+    /** with a memory budget, create entities in descending order of this userData property, so the budget goes
+        to the most important ones first. Entities without it have priority 0, ties keep their file order.
+        Empty for file order */
+    void setBudgetPriorityKey(const Ogre::String& key) { mBudgetPriorityKey = key; }
+    const Ogre::String& getBudgetPriorityKey() const { return mBudgetPriorityKey; }
+
+    void setLightImportMode(LightImportMode mode) { mLightImportMode = mode; }
+    LightImportMode getLightImportMode() const { return mLightImportMode; }
+
+    /// index the entities of a load in LoadResult::bvh
+    void setBuildBVH(bool build) { mBuildBVH = build; }
+    bool getBuildBVH() const { return mBuildBVH; }
+
+    /// keep parsed scenes in directory, see DotSceneCache. An empty directory disables the cache
+    void setCacheDirectory(const Ogre::String& directory) { mCacheDirectory = directory; }
+    const Ogre::String& getCacheDirectory() const { return mCacheDirectory; }
+
+    /** attach a DotScenePlaceholder instead of each entity, the mesh is only loaded once it is found visible
+        @param lazy whether to create placeholders
+        @param distance placeholders further away from the camera are not materialised, 0 for no limit
+    */
+    void setLazyEntities(bool lazy, Ogre::Real distance = 0)
+    {
+        mLazyEntities = lazy;
+        mLazyDistance = distance;
+    }
+    bool getLazyEntities() const { return mLazyEntities; }
+
+    /** create scene nodes without names, so they stay out of the name map of the SceneManager and no prefixed
+        names are built. Their names from the file are kept in LoadResult::nodes instead.
+        Only nodes are affected: Ogre generates a name for every movable object created without one, so all
+        attached objects still go into the name maps */
+    void setUnnamedNodes(bool unnamed) { mUnnamedNodes = unnamed; }
+    bool getUnnamedNodes() const { return mUnnamedNodes; }
+
+    /** create particle systems further than distance from reference with their emitters stopped.
+        They start emitting once a camera within distance renders them. 0 disables it */
+    void setParticleSuspension(Ogre::Real distance, const Ogre::Vector3& reference = Ogre::Vector3::ZERO)
+    {
+        mParticleSuspendDistance = distance;
+        mParticleReference = reference;
+    }
+    /// @}
+
+    /// UserObjectBindings key under which plane entities keep their <plane> definition
+    static const Ogre::String PLANE_BINDING_KEY;
+
+    void sceneManagerDestroyed(Ogre::SceneManager* source);
+    /// materialises the placeholders found visible since the last search
+    void preFindVisibleObjects(Ogre::SceneManager* source, Ogre::SceneManager::IlluminationRenderStage irs,
+                               Ogre::Viewport* v);
+
+    void placeholderVisible(DotScenePlaceholder* placeholder);
+    void placeholderDestroyed(DotScenePlaceholder* placeholder);
 
 protected:
-    void processScene(pugi::xml_node& XMLRoot);
-
-    void processNodes(pugi::xml_node& XMLNode);
-    void processExternals(pugi::xml_node& XMLNode);
-    void processEnvironment(pugi::xml_node& XMLNode);
-    void processTerrainGroup(pugi::xml_node& XMLNode);
-    void processTerrain(pugi::xml_node& XMLNode);
-    void processBlendmaps(pugi::xml_node& XMLNode);
-    void processUserData(pugi::xml_node& XMLNode, Ogre::UserObjectBindings& userData);
-    void processLight(pugi::xml_node& XMLNode, Ogre::SceneNode* pParent = 0);
-    void processCamera(pugi::xml_node& XMLNode, Ogre::SceneNode* pParent = 0);
-
-    void processNode(pugi::xml_node& XMLNode, Ogre::SceneNode* pParent = 0);
-    void processLookTarget(pugi::xml_node& XMLNode, Ogre::SceneNode* pParent);
-    void processTrackTarget(pugi::xml_node& XMLNode, Ogre::SceneNode* pParent);
-    void processEntity(pugi::xml_node& XMLNode, Ogre::SceneNode* pParent);
-    void processParticleSystem(pugi::xml_node& XMLNode, Ogre::SceneNode* pParent);
-    void processBillboardSet(pugi::xml_node& XMLNode, Ogre::SceneNode* pParent);
-    void processPlane(pugi::xml_node& XMLNode, Ogre::SceneNode* pParent);
-
-    void processFog(pugi::xml_node& XMLNode);
-    void processSkyBox(pugi::xml_node& XMLNode);
-    void processSkyDome(pugi::xml_node& XMLNode);
-    void processSkyPlane(pugi::xml_node& XMLNode);
-
-    void processLightRange(pugi::xml_node& XMLNode, Ogre::Light* pLight);
-    void processLightAttenuation(pugi::xml_node& XMLNode, Ogre::Light* pLight);
-
-    Ogre::SceneManager* mSceneMgr;
-    Ogre::SceneNode* mAttachNode;
-    Ogre::String m_sGroupName;
-    Ogre::String m_sPrependNode;
-    Ogre::TerrainGroup* mTerrainGroup;
-    Ogre::ColourValue mBackgroundColour;
+    struct LoadContext;
+    struct ParticleActivator;
+
+    void loadScene(LoadContext& ctx, Ogre::DataStreamPtr& stream);
+    bool readScene(LoadContext& ctx, Ogre::DataStreamPtr& stream);
+    bool parseScene(LoadContext& ctx, Ogre::DataStreamPtr& stream);
+    void publishResult(LoadContext& ctx);
+
+    /// @name Parsing into LoadContext::data
+    /// @{
+    void processScene(LoadContext& ctx, pugi::xml_node& XMLRoot);
+
+    void processNodes(LoadContext& ctx, pugi::xml_node& XMLNode);
+    void processExternals(LoadContext& ctx, pugi::xml_node& XMLNode);
+    void processEnvironment(LoadContext& ctx, pugi::xml_node& XMLNode);
+    void processTerrainGroup(LoadContext& ctx, pugi::xml_node& XMLNode);
+    void processTerrain(LoadContext& ctx, pugi::xml_node& XMLNode);
+    void processBlendmaps(LoadContext& ctx, pugi::xml_node& XMLNode);
+    DotSceneData::UserData processUserData(LoadContext& ctx, pugi::xml_node& XMLNode);
+    void processLight(LoadContext& ctx, pugi::xml_node& XMLNode, int parent = DotSceneData::NO_NODE);
+    void processCamera(LoadContext& ctx, pugi::xml_node& XMLNode, int parent = DotSceneData::NO_NODE);
+
+    void processNode(LoadContext& ctx, pugi::xml_node& XMLNode, int parent = DotSceneData::NO_NODE);
+    void processLookTarget(LoadContext& ctx, pugi::xml_node& XMLNode, int node);
+    void processTrackTarget(LoadContext& ctx, pugi::xml_node& XMLNode, int node);
+    void processInstances(LoadContext& ctx, pugi::xml_node& XMLNode, int parent);
+    void processEntity(LoadContext& ctx, pugi::xml_node& XMLNode, int parent);
+    void processParticleSystem(LoadContext& ctx, pugi::xml_node& XMLNode, int parent);
+    void processBillboardSet(LoadContext& ctx, pugi::xml_node& XMLNode, int parent);
+    void processPlane(LoadContext& ctx, pugi::xml_node& XMLNode, int parent);
+
+    void processFog(LoadContext& ctx, pugi::xml_node& XMLNode);
+    void processSkyBox(LoadContext& ctx, pugi::xml_node& XMLNode);
+    void processSkyDome(LoadContext& ctx, pugi::xml_node& XMLNode);
+    void processSkyPlane(LoadContext& ctx, pugi::xml_node& XMLNode);
+
+    void processLightRange(pugi::xml_node& XMLNode, DotSceneData::Light& light);
+    void processLightAttenuation(pugi::xml_node& XMLNode, DotSceneData::Light& light);
+
+    void resolveTargets(LoadContext& ctx);
+    /// @}
+
+    /// @name Instantiating LoadContext::data
+    /// @{
+    void createScene(LoadContext& ctx);
+    void createEnvironment(LoadContext& ctx);
+    /// start preparing the sky materials in the background, once per load
+    void prefetchSky(LoadContext& ctx);
+    void createSky(LoadContext& ctx);
+    void createNodes(LoadContext& ctx);
+    void createLookTarget(LoadContext& ctx, const DotSceneData::LookTarget& look);
+    void createTrackTarget(LoadContext& ctx, const DotSceneData::TrackTarget& track);
+    void createEntity(LoadContext& ctx, const DotSceneData::Entity& entity);
+    bool createPlaceholder(LoadContext& ctx, const DotSceneData::Entity& entity);
+    void createLight(LoadContext& ctx, const DotSceneData::Light& light);
+    void packLight(LoadContext& ctx, const DotSceneData::Light& light);
+    void createCamera(LoadContext& ctx, const DotSceneData::Camera& camera);
+    void createParticleSystem(LoadContext& ctx, const DotSceneData::ParticleSystem& particles);
+    void createPlane(LoadContext& ctx, const DotSceneData::Plane& plane);
+    void createTerrainGroup(LoadContext& ctx);
+    void applyUserData(LoadContext& ctx, const DotSceneData::UserData& userData, Ogre::UserObjectBindings& bindings);
+    /// @}
+
+    size_t estimateSceneCost(LoadContext& ctx);
+    bool fitsBudget(LoadContext& ctx, size_t bytes);
+    void accountResource(LoadContext& ctx, const Ogre::ResourcePtr& res, MemoryUsage& usage, bool wasResident);
+    void accountTerrain(LoadContext& ctx);
+
+    void addBounds(LoadContext& ctx, const Ogre::AxisAlignedBox& bounds, int node, Ogre::Entity* entity = 0);
+
+    size_t mMemoryBudget;
+    BudgetPolicy mBudgetPolicy;
+    Ogre::String mBudgetPriorityKey;
+    LightImportMode mLightImportMode;
+    bool mBuildBVH;
+    Ogre::String mCacheDirectory;
+    bool mLazyEntities;
+    Ogre::Real mLazyDistance;
+    bool mUnnamedNodes;
+
+    Ogre::Real mParticleSuspendDistance;
+    Ogre::Vector3 mParticleReference;
+
+    DotScenePlaceholderFactory mPlaceholderFactory;
+    bool mOwnsPlaceholderFactory;
+
+    /// results and the terrain groups they own, per SceneManager
+    struct SceneRecord
+    {
+        LoadResult lastResult;
+        std::vector<Ogre::TerrainGroup*> terrainGroups;
+        /// placeholders to materialise before the next visibility search
+        std::vector<DotScenePlaceholder*> pendingPlaceholders;
+        std::vector<std::unique_ptr<ParticleActivator>> particleActivators;
+    };
+
+    mutable std::mutex mMutex;
+    std::map<Ogre::SceneManager*, SceneRecord> mScenes;
+    const LoadResult* mLastResult;
+    LoadResult mEmptyResult;
 };
 
 #endif // DOT_SCENELOADER_H
@@ -0,0 +1,76 @@
+#ifndef DOT_SCENEPLACEHOLDER_H
+#define DOT_SCENEPLACEHOLDER_H
+
+// Includes
+#include <OgreAny.h>
+#include <OgreAxisAlignedBox.h>
+#include <OgreMovableObject.h>
+#include <OgreString.h>
+
+#include <vector>
+
+/** Stands in for an entity whose mesh has not been loaded yet
+
+    It only has bounds and renders nothing. The first time it is found visible, it tells its listener,
+    which is expected to call materialise() outside of the visibility search.
+*/
+class DotScenePlaceholder : public Ogre::MovableObject
+{
+public:
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        /// called from the visibility search, at most once per placeholder
+        virtual void placeholderVisible(DotScenePlaceholder* placeholder) = 0;
+        virtual void placeholderDestroyed(DotScenePlaceholder* placeholder) = 0;
+    };
+
+    explicit DotScenePlaceholder(const Ogre::String& name);
+    ~DotScenePlaceholder();
+
+    /// the entity to create, bounds and radius are the ones of the mesh
+    void setEntity(const Ogre::String& meshFile, const Ogre::String& material, const Ogre::AxisAlignedBox& bounds,
+                   Ogre::Real radius);
+    const Ogre::String& getMeshFile() const { return mMeshFile; }
+
+    /// set on the placeholder and later on the entity
+    void addUserAny(const Ogre::String& key, const Ogre::Any& value);
+
+    void setListener(Listener* listener) { mListener = listener; }
+    Listener* getListener() const { return mListener; }
+
+    /** create the entity and attach it in place of the placeholder
+        The placeholder is detached afterwards and can be destroyed */
+    Ogre::Entity* materialise();
+
+    const Ogre::String& getMovableType() const;
+    const Ogre::AxisAlignedBox& getBoundingBox() const { return mBounds; }
+    Ogre::Real getBoundingRadius() const { return mRadius; }
+    void _updateRenderQueue(Ogre::RenderQueue* queue);
+    void visitRenderables(Ogre::Renderable::Visitor* visitor, bool debugRenderables = false) {}
+
+private:
+    Ogre::String mMeshFile;
+    Ogre::String mMaterial;
+    Ogre::AxisAlignedBox mBounds;
+    Ogre::Real mRadius;
+    std::vector<std::pair<Ogre::String, Ogre::Any>> mUserData;
+
+    Listener* mListener;
+    bool mRequested;
+};
+
+class DotScenePlaceholderFactory : public Ogre::MovableObjectFactory
+{
+public:
+    static const Ogre::String FACTORY_TYPE_NAME;
+
+    const Ogre::String& getType() const { return FACTORY_TYPE_NAME; }
+    void destroyInstance(Ogre::MovableObject* obj);
+
+protected:
+    Ogre::MovableObject* createInstanceImpl(const Ogre::String& name, const Ogre::NameValuePairList* params);
+};
+
+#endif // DOT_SCENEPLACEHOLDER_H
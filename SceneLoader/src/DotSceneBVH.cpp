@@ -0,0 +1,123 @@
+#include "DotSceneBVH.h"
+
+#include <algorithm>
+
+using namespace Ogre;
+
+namespace
+{
+const uint32 MAX_LEAF_SIZE = 4;
+}
+
+void DotSceneBVH::add(const AxisAlignedBox& bounds, Entity* entity)
+{
+    // null and infinite boxes have no center to sort by
+    if (!bounds.isFinite())
+        return;
+
+    mItems.push_back({bounds, entity});
+}
+
+void DotSceneBVH::build()
+{
+    mNodes.clear();
+    if (mItems.empty())
+        return;
+
+    mNodes.reserve(2 * mItems.size() / MAX_LEAF_SIZE + 1);
+    buildNode(0, uint32(mItems.size()));
+}
+
+void DotSceneBVH::clear()
+{
+    mItems.clear();
+    mNodes.clear();
+}
+
+const AxisAlignedBox& DotSceneBVH::getBounds() const
+{
+    return mNodes.empty() ? AxisAlignedBox::BOX_NULL : mNodes.front().bounds;
+}
+
+uint32 DotSceneBVH::buildNode(uint32 first, uint32 count)
+{
+    uint32 index = uint32(mNodes.size());
+    mNodes.push_back(Node());
+
+    AxisAlignedBox bounds;
+    AxisAlignedBox centers;
+    for (uint32 i = first; i < first + count; i++)
+    {
+        bounds.merge(mItems[i].bounds);
+        centers.merge(mItems[i].bounds.getCenter());
+    }
+
+    mNodes[index].bounds = bounds;
+    mNodes[index].first = first;
+    mNodes[index].count = count;
+    mNodes[index].right = 0;
+
+    if (count <= MAX_LEAF_SIZE)
+        return index;
+
+    // split at the median along the axis the centers spread most
+    Vector3 spread = centers.getSize();
+    int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+
+    uint32 half = count / 2;
+    auto begin = mItems.begin() + first;
+    std::nth_element(begin, begin + half, begin + count, [axis](const Item& a, const Item& b) {
+        return a.bounds.getCenter()[axis] < b.bounds.getCenter()[axis];
+    });
+
+    buildNode(first, half);
+    uint32 right = buildNode(first + half, count - half);
+
+    // mNodes may have been reallocated by the recursion
+    mNodes[index].count = 0;
+    mNodes[index].right = right;
+
+    return index;
+}
+
+template <typename Test> void DotSceneBVH::traverse(const Test& test, std::vector<Entity*>& result) const
+{
+    if (mNodes.empty())
+        return;
+
+    uint32 stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top)
+    {
+        const Node& node = mNodes[stack[--top]];
+        if (!test(node.bounds))
+            continue;
+
+        if (node.count)
+        {
+            for (uint32 i = node.first; i < node.first + node.count; i++)
+            {
+                if (test(mItems[i].bounds))
+                    result.push_back(mItems[i].entity);
+            }
+            continue;
+        }
+
+        // the tree is balanced by construction, so the depth stays far below the stack size
+        uint32 index = uint32(&node - &mNodes[0]);
+        stack[top++] = node.right;
+        stack[top++] = index + 1;
+    }
+}
+
+void DotSceneBVH::query(const AxisAlignedBox& box, std::vector<Entity*>& result) const
+{
+    traverse([&box](const AxisAlignedBox& bounds) { return box.intersects(bounds); }, result);
+}
+
+void DotSceneBVH::query(const Ray& ray, std::vector<Entity*>& result) const
+{
+    traverse([&ray](const AxisAlignedBox& bounds) { return ray.intersects(bounds).first; }, result);
+}
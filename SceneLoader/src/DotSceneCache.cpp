@@ -0,0 +1,417 @@
+#include "DotSceneCache.h"
+
+#include <OgreFileSystemLayer.h>
+#include <OgreLogManager.h>
+#include <OgreStringConverter.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+
+using namespace Ogre;
+
+const uint32 DotSceneCache::FORMAT_VERSION = 2;
+
+namespace
+{
+const uint32 CACHE_MAGIC = 0x48435344; // "DSCH"
+
+struct Header
+{
+    uint32 magic;
+    uint32 version;
+    uint32 realSize;
+    uint64 key;
+};
+
+// one function per struct both writes and reads it, depending on the archive
+
+template <typename Archive> void serialize(Archive& ar, Header& header)
+{
+    ar & header.magic & header.version & header.realSize & header.key;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::Property& property)
+{
+    ar & property.name & property.type & property.data;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::UserData& userData)
+{
+    ar & userData.first & userData.count;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::Node& node)
+{
+    ar & node.name & node.parent & node.position & node.orientation & node.scale & node.userData;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::LookTarget& look)
+{
+    ar & look.node & look.target & look.targetName & look.relativeTo & look.position & look.localDirection;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::TrackTarget& track)
+{
+    ar & track.node & track.target & track.targetName & track.localDirection & track.offset;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::Entity& entity)
+{
+    ar & entity.node & entity.name & entity.mesh & entity.material & entity.castShadows & entity.userData;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::Light& light)
+{
+    ar & light.node & light.name & light.type & light.visible & light.castShadows & light.powerScale;
+    ar & light.hasDiffuse & light.diffuse & light.hasSpecular & light.specular;
+    ar & light.hasRange & light.inner & light.outer & light.falloff;
+    ar & light.hasAttenuation & light.range & light.constant & light.linear & light.quadratic;
+    ar & light.userData;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::Camera& camera)
+{
+    ar & camera.node & camera.name & camera.aspectRatio & camera.projectionType;
+    ar & camera.hasClipping & camera.nearDist & camera.farDist & camera.userData;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::ParticleSystem& particles)
+{
+    ar & particles.node & particles.name & particles.templateName & particles.quota;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::Plane& plane)
+{
+    ar & plane.node & plane.name & plane.distance & plane.width & plane.height;
+    ar & plane.xSegments & plane.ySegments & plane.numTexCoordSets & plane.uTile & plane.vTile;
+    ar & plane.material & plane.hasNormals & plane.normal & plane.up & plane.definition;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::Fog& fog)
+{
+    ar & fog.mode & fog.colour & fog.density & fog.start & fog.end;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::SkyBox& sky)
+{
+    ar & sky.material & sky.distance & sky.drawFirst & sky.rotation;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::SkyDome& sky)
+{
+    ar & sky.material & sky.curvature & sky.tiling & sky.distance & sky.drawFirst & sky.rotation;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::SkyPlane& sky)
+{
+    ar & sky.material & sky.normal & sky.d & sky.scale & sky.bow & sky.tiling & sky.drawFirst;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::Environment& env)
+{
+    ar & env.hasFog & env.hasSkyBox & env.hasSkyDome & env.hasSkyPlane & env.hasAmbient & env.hasBackground;
+    ar & env.fog & env.skyBox & env.skyDome & env.skyPlane & env.ambient & env.background;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::TerrainPage& page)
+{
+    ar & page.x & page.y & page.dataFile;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData::TerrainGroup& terrain)
+{
+    ar & terrain.worldSize & terrain.mapSize & terrain.compositeMapDistance & terrain.maxPixelError & terrain.pages;
+}
+
+template <typename Archive> void serialize(Archive& ar, DotSceneData& data)
+{
+    ar & data.hasRootPosition & data.hasRootOrientation & data.hasRootScale;
+    ar & data.rootPosition & data.rootOrientation & data.rootScale;
+    ar & data.environment;
+    ar & data.nodes & data.lookTargets & data.trackTargets;
+    ar & data.entities & data.lights & data.cameras & data.particleSystems & data.planes;
+    ar & data.properties & data.userData & data.meshes;
+    ar & data.hasTerrainGroup & data.terrainGroup;
+}
+
+/// appends values in native byte order, the cache is not meant to be shared between machines
+class Writer
+{
+public:
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value, Writer&>::type operator&(T& value)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        mBuffer.insert(mBuffer.end(), bytes, bytes + sizeof(T));
+        return *this;
+    }
+
+    template <typename T> typename std::enable_if<std::is_class<T>::value, Writer&>::type operator&(T& value)
+    {
+        serialize(*this, value);
+        return *this;
+    }
+
+    template <typename T, typename A> Writer& operator&(std::vector<T, A>& values)
+    {
+        uint32 size = uint32(values.size());
+        *this & size;
+        for (auto& value : values)
+            *this & value;
+        return *this;
+    }
+
+    Writer& operator&(String& value)
+    {
+        uint32 size = uint32(value.size());
+        *this & size;
+        mBuffer.insert(mBuffer.end(), value.begin(), value.end());
+        return *this;
+    }
+
+    Writer& operator&(Vector3& value) { return *this & value.x & value.y & value.z; }
+    Writer& operator&(Quaternion& value) { return *this & value.w & value.x & value.y & value.z; }
+    Writer& operator&(ColourValue& value) { return *this & value.r & value.g & value.b & value.a; }
+
+    const std::vector<char>& getBuffer() const { return mBuffer; }
+
+private:
+    std::vector<char> mBuffer;
+};
+
+/// counterpart of Writer, every read past the end makes it fail
+class Reader
+{
+public:
+    Reader(const char* data, size_t size) : mPos(data), mEnd(data + size), mFailed(false) {}
+
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value, Reader&>::type operator&(T& value)
+    {
+        if (!read(&value, sizeof(T)))
+            value = T();
+        return *this;
+    }
+
+    template <typename T> typename std::enable_if<std::is_class<T>::value, Reader&>::type operator&(T& value)
+    {
+        serialize(*this, value);
+        return *this;
+    }
+
+    template <typename T, typename A> Reader& operator&(std::vector<T, A>& values)
+    {
+        uint32 size = 0;
+        *this & size;
+
+        // every element takes at least one byte, so a corrupt size fails before allocating
+        if (size > remaining())
+            mFailed = true;
+        if (mFailed)
+            return *this;
+
+        values.resize(size);
+        for (auto& value : values)
+            *this & value;
+        return *this;
+    }
+
+    Reader& operator&(bool& value)
+    {
+        uint8 byte = 0;
+        *this & byte;
+        value = byte != 0;
+        return *this;
+    }
+
+    Reader& operator&(String& value)
+    {
+        uint32 size = 0;
+        *this & size;
+
+        if (size > remaining())
+            mFailed = true;
+        if (mFailed)
+            return *this;
+
+        value.assign(mPos, size);
+        mPos += size;
+        return *this;
+    }
+
+    Reader& operator&(Vector3& value) { return *this & value.x & value.y & value.z; }
+    Reader& operator&(Quaternion& value) { return *this & value.w & value.x & value.y & value.z; }
+    Reader& operator&(ColourValue& value) { return *this & value.r & value.g & value.b & value.a; }
+
+    bool failed() const { return mFailed; }
+    bool atEnd() const { return mPos == mEnd; }
+
+private:
+    size_t remaining() const { return size_t(mEnd - mPos); }
+
+    bool read(void* dest, size_t size)
+    {
+        if (mFailed || remaining() < size)
+        {
+            mFailed = true;
+            return false;
+        }
+
+        memcpy(dest, mPos, size);
+        mPos += size;
+        return true;
+    }
+
+    const char* mPos;
+    const char* mEnd;
+    bool mFailed;
+};
+
+uint64 fnv1a(const void* data, size_t size, uint64 hash)
+{
+    const uint8* bytes = static_cast<const uint8*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool isValidRange(const DotSceneData& data, const DotSceneData::UserData& userData)
+{
+    return userData.first <= data.properties.size() && userData.count <= data.properties.size() - userData.first;
+}
+
+/// node references in range, so an entry that was tampered with can not make the loader index out of bounds
+bool isConsistent(const DotSceneData& data)
+{
+    int numNodes = int(data.nodes.size());
+    auto isNode = [numNodes](int index) { return index >= 0 && index < numNodes; };
+    auto isNodeOrNone = [numNodes](int index) { return index >= DotSceneData::NO_NODE && index < numNodes; };
+
+    if (!isValidRange(data, data.userData))
+        return false;
+
+    for (int i = 0; i < numNodes; i++)
+    {
+        // parents precede their children
+        if (data.nodes[i].parent < DotSceneData::NO_NODE || data.nodes[i].parent >= i ||
+            !isValidRange(data, data.nodes[i].userData))
+            return false;
+    }
+
+    for (const auto& look : data.lookTargets)
+        if (!isNode(look.node) || !isNodeOrNone(look.target))
+            return false;
+    for (const auto& track : data.trackTargets)
+        if (!isNode(track.node) || !isNodeOrNone(track.target))
+            return false;
+    for (const auto& entity : data.entities)
+        if (!isNode(entity.node) || entity.mesh >= data.meshes.size() || !isValidRange(data, entity.userData))
+            return false;
+    for (const auto& light : data.lights)
+        if (!isNodeOrNone(light.node) || !isValidRange(data, light.userData))
+            return false;
+    for (const auto& camera : data.cameras)
+        if (!isNodeOrNone(camera.node) || !isValidRange(data, camera.userData))
+            return false;
+    for (const auto& particles : data.particleSystems)
+        if (!isNode(particles.node))
+            return false;
+    for (const auto& plane : data.planes)
+        if (!isNode(plane.node))
+            return false;
+
+    return true;
+}
+} // namespace
+
+DotSceneCache::DotSceneCache(const String& directory) : mDirectory(directory) {}
+
+uint64 DotSceneCache::computeKey(const void* source, size_t size)
+{
+    // seeded with the format version, so updating the loader misses all old entries
+    uint32 seed[2] = {FORMAT_VERSION, uint32(sizeof(Real))};
+    uint64 hash = fnv1a(seed, sizeof(seed), 14695981039346656037ULL);
+    return fnv1a(source, size, hash);
+}
+
+String DotSceneCache::getPath(uint64 key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+    return mDirectory + "/" + name + ".scenecache";
+}
+
+bool DotSceneCache::load(uint64 key, DotSceneData& data) const
+{
+    String path = getPath(key);
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Reader reader(buffer.data(), buffer.size());
+
+    Header header;
+    reader & header;
+    if (reader.failed() || header.magic != CACHE_MAGIC || header.version != FORMAT_VERSION ||
+        header.realSize != sizeof(Real) || header.key != key)
+    {
+        LogManager::getSingleton().logWarning("[DotSceneLoader] ignoring outdated cache entry " + path);
+        return false;
+    }
+
+    DotSceneData loaded;
+    reader & loaded;
+    if (reader.failed() || !reader.atEnd() || !isConsistent(loaded))
+    {
+        LogManager::getSingleton().logWarning("[DotSceneLoader] ignoring corrupt cache entry " + path);
+        return false;
+    }
+
+    data = std::move(loaded);
+    return true;
+}
+
+bool DotSceneCache::save(uint64 key, const DotSceneData& data) const
+{
+    Header header = {CACHE_MAGIC, FORMAT_VERSION, uint32(sizeof(Real)), key};
+
+    // the writer only reads from what it is given
+    Writer writer;
+    writer & header & const_cast<DotSceneData&>(data);
+
+    FileSystemLayer::createDirectory(mDirectory);
+
+    // write to a file of our own first, so concurrent loads never see a partial entry
+    static std::atomic<uint32> counter(0);
+    String path = getPath(key);
+    String tmpPath = path + "." + StringConverter::toString(counter++) + ".tmp";
+
+    {
+        std::ofstream file(tmpPath.c_str(), std::ios::binary);
+        const std::vector<char>& buffer = writer.getBuffer();
+        if (!file.write(buffer.data(), buffer.size()))
+        {
+            LogManager::getSingleton().logWarning("[DotSceneLoader] could not write cache entry " + path);
+            file.close();
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+
+    // fails if another load stored the same entry in the meantime, which is just as good
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,486 @@
+#include "DotSceneExporter.h"
+#include "DotSceneLoader.h"
+#include <Ogre.h>
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <thread>
+
+using namespace Ogre;
+
+/// minimal streaming XML writer. Start tags are closed lazily so attributes can follow
+class XMLStreamWriter
+{
+public:
+    XMLStreamWriter(std::ostream& out, int depth = 0) : mOut(out), mDepth(depth), mTagOpen(false)
+    {
+        // numbers are always written with '.', whatever the global locale
+        mNumber.imbue(std::locale::classic());
+        mNumber.precision(std::numeric_limits<Real>::max_digits10);
+    }
+
+    void startElement(const char* name)
+    {
+        closeStartTag();
+        indent();
+        mOut << '<' << name;
+        mStack.push_back(name);
+        mTagOpen = true;
+    }
+
+    void endElement()
+    {
+        const char* name = mStack.back();
+        mStack.pop_back();
+
+        if (mTagOpen)
+        {
+            mOut << " />\n";
+            mTagOpen = false;
+            return;
+        }
+
+        indent();
+        mOut << "</" << name << ">\n";
+    }
+
+    void attribute(const char* name, const String& value)
+    {
+        mOut << ' ' << name << "=\"";
+        escape(value);
+        mOut << '"';
+    }
+
+    void attribute(const char* name, Real value)
+    {
+        // StringConverter constructs a stringstream per value, which dominates on large scenes. Reuse one instead
+        mNumber.str(String());
+        mNumber << value;
+        mOut << ' ' << name << "=\"" << mNumber.str() << '"';
+    }
+
+    void attribute(const char* name, int value) { mOut << ' ' << name << "=\"" << value << '"'; }
+
+    void attribute(const char* name, bool value) { mOut << ' ' << name << "=\"" << (value ? "true" : "false") << '"'; }
+
+    /// write an already serialized fragment, e.g. the output of another writer at the same depth
+    void raw(const String& text)
+    {
+        closeStartTag();
+        mOut << text;
+    }
+
+    int getDepth() const { return mDepth + int(mStack.size()); }
+
+private:
+    void closeStartTag()
+    {
+        if (!mTagOpen)
+            return;
+
+        mOut << ">\n";
+        mTagOpen = false;
+    }
+
+    void indent()
+    {
+        for (int i = 0; i < getDepth(); i++)
+            mOut << "    ";
+    }
+
+    void escape(const String& value)
+    {
+        for (char c : value)
+        {
+            switch (c)
+            {
+            case '&':
+                mOut << "&amp;";
+                break;
+            case '<':
+                mOut << "&lt;";
+                break;
+            case '>':
+                mOut << "&gt;";
+                break;
+            case '"':
+                mOut << "&quot;";
+                break;
+            default:
+                mOut << c;
+            }
+        }
+    }
+
+    std::ostream& mOut;
+    std::ostringstream mNumber;
+    int mDepth;
+    bool mTagOpen;
+    std::vector<const char*> mStack;
+};
+
+namespace
+{
+void writeVector3(XMLStreamWriter& writer, const char* name, const Vector3& v)
+{
+    writer.startElement(name);
+    writer.attribute("x", v.x);
+    writer.attribute("y", v.y);
+    writer.attribute("z", v.z);
+    writer.endElement();
+}
+
+void writeQuaternion(XMLStreamWriter& writer, const char* name, const Quaternion& q)
+{
+    writer.startElement(name);
+    writer.attribute("qw", q.w);
+    writer.attribute("qx", q.x);
+    writer.attribute("qy", q.y);
+    writer.attribute("qz", q.z);
+    writer.endElement();
+}
+
+void writeColour(XMLStreamWriter& writer, const char* name, const ColourValue& c)
+{
+    writer.startElement(name);
+    writer.attribute("r", c.r);
+    writer.attribute("g", c.g);
+    writer.attribute("b", c.b);
+    if (c.a != 1)
+        writer.attribute("a", c.a);
+    writer.endElement();
+}
+
+void writeTransform(XMLStreamWriter& writer, const Node* node)
+{
+    if (node->getPosition() != Vector3::ZERO)
+        writeVector3(writer, "position", node->getPosition());
+
+    if (node->getOrientation() != Quaternion::IDENTITY)
+        writeQuaternion(writer, "rotation", node->getOrientation());
+
+    if (node->getScale() != Vector3::UNIT_SCALE)
+        writeVector3(writer, "scale", node->getScale());
+}
+} // namespace
+
+DotSceneExporter::DotSceneExporter() : mParallel(false), mHasBackgroundColour(false) {}
+
+void DotSceneExporter::exportScene(SceneNode* rootNode, const String& outFileName)
+{
+    std::ofstream out(outFileName.c_str(), std::ios::out | std::ios::binary);
+    if (!out)
+        OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "cannot open " + outFileName, "DotSceneExporter::exportScene");
+
+    exportScene(rootNode, out);
+
+    if (!out)
+        OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "error writing " + outFileName,
+                    "DotSceneExporter::exportScene");
+}
+
+void DotSceneExporter::exportScene(SceneNode* rootNode, std::ostream& out)
+{
+    XMLStreamWriter writer(out);
+
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+
+    writer.startElement("scene");
+    writer.attribute("formatVersion", String("1.1"));
+
+    writer.startElement("nodes");
+
+    const Node::ChildNodeMap& children = rootNode->getChildren();
+
+    size_t numTasks = std::min<size_t>(std::thread::hardware_concurrency(), children.size());
+    if (!mParallel || numTasks < 2)
+    {
+        for (auto c : children)
+            writeNode(writer, static_cast<SceneNode*>(c));
+    }
+    else
+    {
+        // subtrees are independent, so each task serializes a contiguous range of them into its own buffer.
+        // The buffers are then appended in order, which keeps the output deterministic
+        int depth = writer.getDepth();
+        size_t perTask = (children.size() + numTasks - 1) / numTasks;
+
+        std::vector<std::future<String>> tasks;
+        for (size_t begin = 0; begin < children.size(); begin += perTask)
+        {
+            size_t end = std::min(begin + perTask, children.size());
+            tasks.push_back(std::async(std::launch::async, [this, &children, begin, end, depth]() {
+                std::ostringstream buffer;
+                XMLStreamWriter taskWriter(buffer, depth);
+                for (size_t i = begin; i < end; i++)
+                    writeNode(taskWriter, static_cast<SceneNode*>(children[i]));
+                return buffer.str();
+            }));
+        }
+
+        for (auto& t : tasks)
+            writer.raw(t.get());
+    }
+
+    if (rootNode->numAttachedObjects())
+        LogManager::getSingleton().logWarning("[DotSceneExporter] objects attached to the root node are not exported");
+
+    writeTransform(writer, rootNode);
+
+    writer.endElement(); // nodes
+
+    // the DTD wants it after <nodes>
+    writeEnvironment(writer, rootNode->getCreator());
+
+    writer.endElement(); // scene
+}
+
+void DotSceneExporter::writeEnvironment(XMLStreamWriter& writer, SceneManager* sceneMgr)
+{
+    writer.startElement("environment");
+
+    if (sceneMgr->getFogMode() != FOG_NONE)
+    {
+        static const char* modes[] = {"none", "exp", "exp2", "linear"};
+
+        writer.startElement("fog");
+        writer.attribute("mode", String(modes[sceneMgr->getFogMode()]));
+        writer.attribute("density", sceneMgr->getFogDensity());
+        writer.attribute("start", sceneMgr->getFogStart());
+        writer.attribute("end", sceneMgr->getFogEnd());
+        writeColour(writer, "colour", sceneMgr->getFogColour());
+        writer.endElement();
+    }
+
+    writeColour(writer, "colourAmbient", sceneMgr->getAmbientLight());
+
+    if (mHasBackgroundColour)
+        writeColour(writer, "colourBackground", mBackgroundColour);
+
+    writer.endElement();
+}
+
+void DotSceneExporter::writeNode(XMLStreamWriter& writer, const SceneNode* node)
+{
+    writer.startElement("node");
+    writer.attribute("name", node->getName());
+
+    writeTransform(writer, node);
+
+    // lookTarget is baked into the orientation above, trackTarget is not exported
+
+    const UserObjectBindings& userData = node->getUserObjectBindings();
+    writeUserData(writer, userData);
+
+    for (auto c : node->getChildren())
+        writeNode(writer, static_cast<SceneNode*>(c));
+
+    // the DTD wants the objects grouped by type, in this order
+    std::vector<const Entity*> entities, planes;
+    std::vector<const Light*> lights;
+    std::vector<const Camera*> cameras;
+    for (auto mo : node->getAttachedObjects())
+    {
+        const String& type = mo->getMovableType();
+        if (type == EntityFactory::FACTORY_TYPE_NAME)
+        {
+            const Entity* entity = static_cast<Entity*>(mo);
+            bool isPlane = !entity->getUserObjectBindings().getUserAny(DotSceneLoader::PLANE_BINDING_KEY).isEmpty();
+            (isPlane ? planes : entities).push_back(entity);
+        }
+        else if (type == LightFactory::FACTORY_TYPE_NAME)
+            lights.push_back(static_cast<Light*>(mo));
+        else if (type == "Camera")
+            cameras.push_back(static_cast<Camera*>(mo));
+        else
+            LogManager::getSingleton().logWarning("[DotSceneExporter] skipping unsupported object " +
+                                                  mo->getName() + " of type " + type);
+    }
+
+    for (auto entity : entities)
+        writeEntity(writer, entity);
+    for (auto light : lights)
+        writeLight(writer, light);
+    for (auto camera : cameras)
+        writeCamera(writer, camera);
+    for (auto plane : planes)
+        writeEntity(writer, plane);
+
+    writer.endElement();
+}
+
+void DotSceneExporter::writeEntity(XMLStreamWriter& writer, const Entity* entity)
+{
+    const UserObjectBindings& userData = entity->getUserObjectBindings();
+
+    // planes have no mesh file to refer to, so the loader keeps their original definition around
+    const Any& planeDef = userData.getUserAny(DotSceneLoader::PLANE_BINDING_KEY);
+    if (!planeDef.isEmpty())
+    {
+        writer.raw(any_cast<String>(planeDef));
+        return;
+    }
+
+    const MeshPtr& mesh = entity->getMesh();
+    if (mesh->isManuallyLoaded())
+    {
+        LogManager::getSingleton().logWarning("[DotSceneExporter] skipping entity " + entity->getName() +
+                                              " with manual mesh " + mesh->getName());
+        return;
+    }
+
+    writer.startElement("entity");
+    writer.attribute("name", entity->getName());
+    writer.attribute("meshFile", mesh->getName());
+
+    // only a material that overrides the mesh default for all subentities can be expressed
+    if (entity->getNumSubEntities() > 0)
+    {
+        const String& material = entity->getSubEntity(0)->getMaterialName();
+        bool shared = true;
+        for (size_t i = 1; i < entity->getNumSubEntities() && shared; i++)
+            shared = entity->getSubEntity(i)->getMaterialName() == material;
+
+        if (shared && material != mesh->getSubMesh(0)->getMaterialName())
+            writer.attribute("material", material);
+    }
+
+    if (!entity->getCastShadows())
+        writer.attribute("castShadows", false);
+
+    writeUserData(writer, userData);
+
+    writer.endElement();
+}
+
+void DotSceneExporter::writeLight(XMLStreamWriter& writer, const Light* light)
+{
+    // newer Ogre versions have light types the format can not express
+    const char* type;
+    switch (light->getType())
+    {
+    case Light::LT_POINT:
+        type = "point";
+        break;
+    case Light::LT_DIRECTIONAL:
+        type = "directional";
+        break;
+    case Light::LT_SPOTLIGHT:
+        type = "spot";
+        break;
+    default:
+        LogManager::getSingleton().logWarning("[DotSceneExporter] skipping light " + light->getName() +
+                                              " of unsupported type");
+        return;
+    }
+
+    writer.startElement("light");
+    writer.attribute("name", light->getName());
+    writer.attribute("type", String(type));
+    if (!light->getVisible())
+        writer.attribute("visible", false);
+    writer.attribute("castShadows", light->getCastShadows());
+    if (light->getPowerScale() != 1)
+        writer.attribute("powerScale", light->getPowerScale());
+
+    writeColour(writer, "colourDiffuse", light->getDiffuseColour());
+    writeColour(writer, "colourSpecular", light->getSpecularColour());
+
+    if (light->getType() == Light::LT_SPOTLIGHT)
+    {
+        writer.startElement("lightRange");
+        writer.attribute("inner", light->getSpotlightInnerAngle().valueAngleUnits());
+        writer.attribute("outer", light->getSpotlightOuterAngle().valueAngleUnits());
+        writer.attribute("falloff", light->getSpotlightFalloff());
+        writer.endElement();
+    }
+
+    if (light->getType() != Light::LT_DIRECTIONAL)
+    {
+        writer.startElement("lightAttenuation");
+        writer.attribute("range", light->getAttenuationRange());
+        writer.attribute("constant", light->getAttenuationConstant());
+        writer.attribute("linear", light->getAttenuationLinear());
+        writer.attribute("quadratic", light->getAttenuationQuadric());
+        writer.endElement();
+    }
+
+    writeUserData(writer, light->getUserObjectBindings());
+
+    writer.endElement();
+}
+
+void DotSceneExporter::writeCamera(XMLStreamWriter& writer, const Camera* camera)
+{
+    writer.startElement("camera");
+    writer.attribute("name", camera->getName());
+    writer.attribute("fov", camera->getFOVy().valueAngleUnits());
+    writer.attribute("aspectRatio", camera->getAspectRatio());
+    writer.attribute("projectionType",
+                     String(camera->getProjectionType() == PT_PERSPECTIVE ? "perspective" : "orthographic"));
+
+    writer.startElement("clipping");
+    writer.attribute("near", camera->getNearClipDistance());
+    writer.attribute("far", camera->getFarClipDistance());
+    writer.endElement();
+
+    writeUserData(writer, static_cast<const MovableObject*>(camera)->getUserObjectBindings());
+
+    writer.endElement();
+}
+
+void DotSceneExporter::writeUserData(XMLStreamWriter& writer, const UserObjectBindings& userData)
+{
+    bool started = false;
+    for (const auto& key : mUserDataKeys)
+    {
+        const Any& value = userData.getUserAny(key);
+        if (value.isEmpty())
+            continue;
+
+        if (!started)
+        {
+            writer.startElement("userData");
+            started = true;
+        }
+
+        writer.startElement("property");
+        writer.attribute("name", key);
+
+        const std::type_info& type = value.getType();
+        if (type == typeid(bool))
+        {
+            writer.attribute("type", String("bool"));
+            writer.attribute("data", any_cast<bool>(value));
+        }
+        else if (type == typeid(Real))
+        {
+            writer.attribute("type", String("float"));
+            writer.attribute("data", any_cast<Real>(value));
+        }
+        else if (type == typeid(int))
+        {
+            writer.attribute("type", String("int"));
+            writer.attribute("data", any_cast<int>(value));
+        }
+        else if (type == typeid(String))
+        {
+            writer.attribute("type", String("str"));
+            writer.attribute("data", any_cast<String>(value));
+        }
+        else
+        {
+            LogManager::getSingleton().logWarning("[DotSceneExporter] skipping userData " + key +
+                                                  " of unsupported type");
+        }
+
+        writer.endElement();
+    }
+
+    if (started)
+        writer.endElement();
+}
@@ -1,5 +1,7 @@
 #include "DotSceneLoader.h"
+#include "DotSceneCache.h"
 #include <Ogre.h>
+#include <OgreBitwise.h>
 #include <OgreTerrain.h>
 #include <OgreTerrainGroup.h>
 #include <OgreTerrainMaterialGeneratorA.h>
@@ -8,6 +10,20 @@
 
 #include <pugixml.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <locale>
+#include <sstream>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
 using namespace Ogre;
 
 namespace
@@ -91,6 +107,10 @@ Quaternion parseQuaternion(const pugi::xml_node& XMLNode)
         orientation.z = StringConverter::parseReal(XMLNode.attribute("z").value());
     }
 
+    // Node::setOrientation normalises, which turns a zero rotation into NaNs
+    if (orientation.Norm() == 0)
+        return Quaternion::IDENTITY;
+
     return orientation;
 }
 
@@ -101,481 +121,2050 @@ ColourValue parseColour(pugi::xml_node& XMLNode)
                        StringConverter::parseReal(XMLNode.attribute("b").value()),
                        XMLNode.attribute("a") != NULL ? StringConverter::parseReal(XMLNode.attribute("a").value()) : 1);
 }
-} // namespace
 
-DotSceneLoader::DotSceneLoader() : mSceneMgr(0), mTerrainGroup(0), mBackgroundColour(ColourValue::Black)
+/// size of a resource file without opening it, 0 if unknown
+size_t getResourceFileSize(const String& name, const String& group)
 {
-    SceneLoaderManager::getSingleton().registerSceneLoader("DotScene", {".scene"}, this);
+    FileInfoListPtr files = ResourceGroupManager::getSingleton().findResourceFileInfo(group, name);
+    return files->empty() ? 0 : files->front().uncompressedSize;
 }
 
-DotSceneLoader::~DotSceneLoader()
+// chunks of the binary .mesh format
+const uint16 M_HEADER = 0x1000;
+const uint16 M_MESH = 0x3000;
+const uint16 M_MESH_BOUNDS = 0x9000;
+const size_t MESH_CHUNK_HEADER_SIZE = sizeof(uint16) + sizeof(uint32);
+
+/// bounds of a .mesh file without loading it, by skipping from chunk to chunk
+bool readMeshBounds(const String& meshFile, const String& group, AxisAlignedBox& bounds, Real& radius)
 {
-    SceneLoaderManager::getSingleton().unregisterSceneLoader("DotScene");
+    DataStreamPtr stream;
+    try
+    {
+        stream = ResourceGroupManager::getSingleton().openResource(meshFile, group);
+    }
+    catch (Exception& /*e*/)
+    {
+        return false;
+    }
+
+    uint16 id = 0;
+    if (stream->read(&id, sizeof(id)) != sizeof(id))
+        return false;
+
+    // the header id tells the byte order of the file
+    bool swap = id != M_HEADER;
+    if (swap && Bitwise::bswap16(id) != M_HEADER)
+        return false;
+
+    // version string
+    stream->getLine();
 
-    if (mTerrainGroup)
+    auto readChunk = [&](uint16& chunkId, uint32& length) -> bool {
+        if (stream->read(&chunkId, sizeof(chunkId)) != sizeof(chunkId) ||
+            stream->read(&length, sizeof(length)) != sizeof(length))
+            return false;
+
+        if (swap)
+        {
+            chunkId = Bitwise::bswap16(chunkId);
+            length = Bitwise::bswap32(length);
+        }
+        return length >= MESH_CHUNK_HEADER_SIZE;
+    };
+
+    uint16 chunkId;
+    uint32 length;
+    if (!readChunk(chunkId, length) || chunkId != M_MESH)
+        return false;
+
+    size_t meshEnd = stream->tell() - MESH_CHUNK_HEADER_SIZE + length;
+
+    // skeletally animated flag
+    stream->skip(sizeof(bool));
+
+    while (stream->tell() < meshEnd && readChunk(chunkId, length))
     {
-        OGRE_DELETE mTerrainGroup;
+        if (chunkId != M_MESH_BOUNDS)
+        {
+            stream->skip(long(length - MESH_CHUNK_HEADER_SIZE));
+            continue;
+        }
+
+        // minimum, maximum and radius
+        uint32 values[7];
+        if (stream->read(values, sizeof(values)) != sizeof(values))
+            return false;
+
+        float floats[7];
+        for (int i = 0; i < 7; i++)
+        {
+            if (swap)
+                values[i] = Bitwise::bswap32(values[i]);
+            memcpy(&floats[i], &values[i], sizeof(float));
+        }
+
+        bounds.setExtents(Vector3(floats[0], floats[1], floats[2]), Vector3(floats[3], floats[4], floats[5]));
+        radius = floats[6];
+        return true;
     }
-}
 
-void DotSceneLoader::parseDotScene(const String& SceneName, const String& groupName, SceneNode* pAttachNode,
-                                   const String& sPrependNode)
-{
-    m_sPrependNode = sPrependNode;
-    DataStreamPtr stream = Root::openFileStream(SceneName, groupName);
-    load(stream, groupName, pAttachNode);
+    return false;
 }
 
-void DotSceneLoader::load(DataStreamPtr& stream, const String& groupName, SceneNode* rootNode)
+/// height and delta data of all pages
+size_t estimateTerrainCost(const DotSceneData::TerrainGroup& terrainGroup)
 {
-    m_sGroupName = groupName;
-    mSceneMgr = rootNode->getCreator();
+    size_t mapSize = terrainGroup.mapSize;
+    return terrainGroup.pages.size() * mapSize * mapSize * sizeof(float) * 2;
+}
 
-    pugi::xml_document XMLDoc; // character type defaults to char
+/// TerrainGlobalOptions are read while terrains are created and loaded, so terrain loads are serialised
+std::mutex terrainMutex;
 
-    auto result = XMLDoc.load_buffer(stream->getAsString().c_str(), stream->size());
-    if (!result)
-    {
-        LogManager::getSingleton().stream(LML_CRITICAL) << "[DotSceneLoader] " << result.description();
-        return;
-    }
+/// plane meshes live in the global MeshManager, so their names must be unique across loads and SceneManagers
+std::atomic<uint32> planeMeshCounter(0);
 
-    // Grab the scene node
-    auto XMLRoot = XMLDoc.child("scene");
+/// (segments + 1)^2 vertices still fit 16 bit indices
+const int MAX_PLANE_SEGMENTS = 255;
 
-    // Validate the File
-    if (getAttrib(XMLRoot, "formatVersion", "") == "")
-    {
-        LogManager::getSingleton().logError("[DotSceneLoader] Invalid .scene File. Missing <scene>");
-        return;
-    }
+const uint32 ZSTD_FRAME_MAGIC = 0xFD2FB528;
+const uint32 LZ4_FRAME_MAGIC = 0x184D2204;
+const size_t STREAM_CHUNK_SIZE = 64 * 1024;
 
-    // figure out where to attach any nodes we create
-    mAttachNode = rootNode;
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+/// the content size in a frame header is untrusted, so only reserve what the compressed data plausibly expands to.
+/// The buffer still grows past that if the data really is larger
+size_t getReserveSize(const DataStreamPtr& stream, unsigned long long contentSize)
+{
+    const unsigned long long MAX_RATIO = 16;
+    const unsigned long long MAX_RESERVE = 256 * 1024 * 1024;
 
-    // Process the scene
-    processScene(XMLRoot);
+    unsigned long long limit = std::max<unsigned long long>(stream->size(), STREAM_CHUNK_SIZE) * MAX_RATIO;
+    return size_t(std::min(contentSize, std::min(limit, MAX_RESERVE)));
 }
+#endif
 
-void DotSceneLoader::processScene(pugi::xml_node& XMLRoot)
+#ifdef HAVE_ZSTD
+/// decompress chunk by chunk straight into the parse buffer
+bool decompressZstd(DataStreamPtr& stream, std::vector<char>& in, size_t inSize, std::vector<char>& buffer)
 {
-    // Process the scene parameters
-    String version = getAttrib(XMLRoot, "formatVersion", "unknown");
+    std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream*)> dstream(ZSTD_createDStream(), ZSTD_freeDStream);
+    ZSTD_initDStream(dstream.get());
 
-    String message = "[DotSceneLoader] Parsing dotScene file with version " + version;
-    if (XMLRoot.attribute("ID"))
-        message += ", id " + String(XMLRoot.attribute("ID").value());
-    if (XMLRoot.attribute("sceneManager"))
-        message += ", scene manager " + String(XMLRoot.attribute("sceneManager").value());
-    if (XMLRoot.attribute("minOgreVersion"))
-        message += ", min. Ogre version " + String(XMLRoot.attribute("minOgreVersion").value());
-    if (XMLRoot.attribute("author"))
-        message += ", author " + String(XMLRoot.attribute("author").value());
+    // reserve the output if the frame header tells the size
+    unsigned long long contentSize = ZSTD_getFrameContentSize(in.data(), inSize);
+    if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize != ZSTD_CONTENTSIZE_ERROR)
+        buffer.reserve(getReserveSize(stream, contentSize));
 
-    LogManager::getSingleton().logMessage(message);
+    size_t ret = 0;
+    for (;;)
+    {
+        ZSTD_inBuffer input = {in.data(), inSize, 0};
 
-    // Process environment (?)
-    if (auto pElement = XMLRoot.child("environment"))
-        processEnvironment(pElement);
+        // keep going while the decoder fills the output, it might hold back data otherwise
+        bool outputFull = true;
+        while (input.pos < input.size || outputFull)
+        {
+            size_t used = buffer.size();
+            buffer.resize(used + STREAM_CHUNK_SIZE);
 
-    // Process nodes (?)
-    if (auto pElement = XMLRoot.child("nodes"))
-        processNodes(pElement);
+            ZSTD_outBuffer output = {buffer.data() + used, STREAM_CHUNK_SIZE, 0};
+            ret = ZSTD_decompressStream(dstream.get(), &output, &input);
+            buffer.resize(used + output.pos);
 
-    // Process externals (?)
-    if (auto pElement = XMLRoot.child("externals"))
-        processExternals(pElement);
+            if (ZSTD_isError(ret))
+            {
+                LogManager::getSingleton().logError(String("[DotSceneLoader] ") + ZSTD_getErrorName(ret));
+                return false;
+            }
 
-    // Process userDataReference (?)
-    if (auto pElement = XMLRoot.child("userData"))
-        processUserData(pElement, mAttachNode->getUserObjectBindings());
+            outputFull = output.pos == output.size;
+        }
 
-    // Process light (?)
-    if (auto pElement = XMLRoot.child("light"))
-        processLight(pElement);
+        if (!inSize)
+            break;
 
-    // Process camera (?)
-    if (auto pElement = XMLRoot.child("camera"))
-        processCamera(pElement);
+        inSize = stream->read(in.data(), in.size());
+    }
 
-    // Process terrain (?)
-    if (auto pElement = XMLRoot.child("terrainGroup"))
-        processTerrainGroup(pElement);
+    if (ret != 0)
+        LogManager::getSingleton().logWarning("[DotSceneLoader] truncated zstd stream");
+
+    return true;
 }
+#endif
 
-void DotSceneLoader::processNodes(pugi::xml_node& XMLNode)
+#ifdef HAVE_LZ4
+/// decompress chunk by chunk straight into the parse buffer
+bool decompressLZ4(DataStreamPtr& stream, std::vector<char>& in, size_t inSize, std::vector<char>& buffer)
 {
-    // Process node (*)
-    for (auto pElement : XMLNode.children("node"))
+    LZ4F_dctx* dctx = NULL;
+    LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+    std::unique_ptr<LZ4F_dctx, LZ4F_errorCode_t (*)(LZ4F_dctx*)> context(dctx, LZ4F_freeDecompressionContext);
+
+    // reserve the output if the frame header tells the size
+    LZ4F_frameInfo_t info = {};
+    size_t consumed = inSize;
+    size_t ret = LZ4F_getFrameInfo(dctx, &info, in.data(), &consumed);
+    if (LZ4F_isError(ret))
     {
-        processNode(pElement);
+        LogManager::getSingleton().logError(String("[DotSceneLoader] ") + LZ4F_getErrorName(ret));
+        return false;
     }
 
-    // Process position (?)
-    if (auto pElement = XMLNode.child("position"))
+    if (info.contentSize)
+        buffer.reserve(getReserveSize(stream, info.contentSize));
+
+    size_t pos = consumed;
+    for (;;)
     {
-        mAttachNode->setPosition(parseVector3(pElement));
-        mAttachNode->setInitialState();
+        // keep going while the decoder fills the output, it might hold back data otherwise
+        bool outputFull = true;
+        while (pos < inSize || outputFull)
+        {
+            size_t used = buffer.size();
+            buffer.resize(used + STREAM_CHUNK_SIZE);
+
+            size_t dstSize = STREAM_CHUNK_SIZE;
+            size_t srcSize = inSize - pos;
+            ret = LZ4F_decompress(dctx, buffer.data() + used, &dstSize, in.data() + pos, &srcSize, NULL);
+            buffer.resize(used + dstSize);
+            pos += srcSize;
+
+            if (LZ4F_isError(ret))
+            {
+                LogManager::getSingleton().logError(String("[DotSceneLoader] ") + LZ4F_getErrorName(ret));
+                return false;
+            }
+
+            outputFull = dstSize == STREAM_CHUNK_SIZE;
+        }
+
+        if (!inSize)
+            break;
+
+        inSize = stream->read(in.data(), in.size());
+        pos = 0;
     }
 
-    // Process rotation (?)
-    if (auto pElement = XMLNode.child("rotation"))
+    if (ret != 0)
+        LogManager::getSingleton().logWarning("[DotSceneLoader] truncated lz4 stream");
+
+    return true;
+}
+#endif
+
+/// read the whole stream into buffer, decompressing it if needed
+bool readSceneStream(DataStreamPtr& stream, std::vector<char>& buffer)
+{
+    std::vector<char> in(STREAM_CHUNK_SIZE);
+    size_t inSize = stream->read(in.data(), in.size());
+
+    uint32 magic = 0;
+    if (inSize >= sizeof(magic))
+        memcpy(&magic, in.data(), sizeof(magic));
+#if OGRE_ENDIAN == OGRE_ENDIAN_BIG
+    magic = Bitwise::bswap32(magic);
+#endif
+
+    if (magic == ZSTD_FRAME_MAGIC)
     {
-        mAttachNode->setOrientation(parseQuaternion(pElement));
-        mAttachNode->setInitialState();
+#ifdef HAVE_ZSTD
+        return decompressZstd(stream, in, inSize, buffer);
+#else
+        LogManager::getSingleton().logError("[DotSceneLoader] built without zstd support");
+        return false;
+#endif
     }
 
-    // Process scale (?)
-    if (auto pElement = XMLNode.child("scale"))
+    if (magic == LZ4_FRAME_MAGIC)
+    {
+#ifdef HAVE_LZ4
+        return decompressLZ4(stream, in, inSize, buffer);
+#else
+        LogManager::getSingleton().logError("[DotSceneLoader] built without lz4 support");
+        return false;
+#endif
+    }
+
+    // plain text, read the rest straight behind the first chunk
+    buffer.assign(in.begin(), in.begin() + inSize);
+    if (stream->size() > inSize)
+        buffer.reserve(stream->size());
+
+    while (!stream->eof())
     {
-        mAttachNode->setScale(parseVector3(pElement));
-        mAttachNode->setInitialState();
+        size_t used = buffer.size();
+        buffer.resize(used + STREAM_CHUNK_SIZE);
+
+        size_t read = stream->read(buffer.data() + used, STREAM_CHUNK_SIZE);
+        buffer.resize(used + read);
+        if (!read)
+            break;
     }
+
+    return true;
 }
 
-void DotSceneLoader::processExternals(pugi::xml_node& XMLNode)
+/// transforms of an <instances> element, one array per component
+struct InstanceArrays
 {
-    //! @todo Implement this
-}
+    std::vector<float> px, py, pz;
+    std::vector<float> qw, qx, qy, qz;
+    std::vector<float> sx, sy, sz;
 
-void DotSceneLoader::processEnvironment(pugi::xml_node& XMLNode)
+    /// identity transforms, for the arrays a scene leaves out
+    void resize(size_t count)
+    {
+        for (auto array : {&px, &py, &pz, &qx, &qy, &qz})
+            array->assign(count, 0.0f);
+        for (auto array : {&qw, &sx, &sy, &sz})
+            array->assign(count, 1.0f);
+    }
+};
+
+/// splits count tuples of numComponents floats into one array per component
+void deinterleave(const float* values, size_t count, float* const* components, size_t numComponents)
 {
-    // Process camera (?)
-    if (auto pElement = XMLNode.child("camera"))
-        processCamera(pElement);
+    for (size_t c = 0; c < numComponents; c++)
+    {
+        float* component = components[c];
+        for (size_t i = 0; i < count; i++)
+            component[i] = values[i * numComponents + c];
+    }
+}
 
-    // Process fog (?)
-    if (auto pElement = XMLNode.child("fog"))
-        processFog(pElement);
+/// a missing element keeps the arrays as they are, otherwise it has to hold exactly count tuples
+bool parseInstanceArray(const pugi::xml_node& XMLNode, size_t count, float* const* components,
+                        size_t numComponents)
+{
+    if (!XMLNode)
+        return true;
 
-    // Process skyBox (?)
-    if (auto pElement = XMLNode.child("skyBox"))
-        processSkyBox(pElement);
+    std::vector<float> values;
+    values.reserve(count * numComponents);
 
-    // Process skyDome (?)
-    if (auto pElement = XMLNode.child("skyDome"))
-        processSkyDome(pElement);
+    // strtof follows the global C locale, which might use a decimal comma
+    std::istringstream text(XMLNode.child_value());
+    text.imbue(std::locale::classic());
 
-    // Process skyPlane (?)
-    if (auto pElement = XMLNode.child("skyPlane"))
-        processSkyPlane(pElement);
+    float value;
+    while (text >> value)
+        values.push_back(value);
 
-    // Process colourAmbient (?)
-    if (auto pElement = XMLNode.child("colourAmbient"))
-        mSceneMgr->setAmbientLight(parseColour(pElement));
+    if (values.size() != count * numComponents)
+        return false;
 
-    // Process colourBackground (?)
-    if (auto pElement = XMLNode.child("colourBackground"))
-        mBackgroundColour = parseColour(pElement);
+    deinterleave(values.data(), count, components, numComponents);
+    return true;
 }
 
-void DotSceneLoader::processTerrainGroup(pugi::xml_node& XMLNode)
+/// little endian floats: count positions, count rotations as w x y z and count scales
+bool readInstances(const DataStreamPtr& stream, size_t count, InstanceArrays& instances)
 {
-    Real worldSize = getAttribReal(XMLNode, "worldSize");
-    int mapSize = StringConverter::parseInt(XMLNode.attribute("size").value());
-    // TODO: unused
-    // bool colourmapEnabled = getAttribBool(XMLNode, "colourmapEnabled");
-    // int colourMapTextureSize = StringConverter::parseInt(XMLNode.attribute("colourMapTextureSize").value());
-    int compositeMapDistance = StringConverter::parseInt(XMLNode.attribute("tuningCompositeMapDistance").value());
-    int maxPixelError = StringConverter::parseInt(XMLNode.attribute("tuningMaxPixelError").value());
+    // checked before allocating anything, count comes straight from the file
+    size_t bytes = count * 10 * sizeof(float);
+    if (stream->size() != bytes)
+        return false;
 
-    auto terrainGlobalOptions = TerrainGlobalOptions::getSingletonPtr();
-    OgreAssert(terrainGlobalOptions, "TerrainGlobalOptions not available");
+    std::vector<float> values(count * 10);
+    if (stream->read(values.data(), bytes) != bytes)
+        return false;
 
-    terrainGlobalOptions->setMaxPixelError((Real)maxPixelError);
-    terrainGlobalOptions->setCompositeMapDistance((Real)compositeMapDistance);
+    instances.resize(count);
 
-    mTerrainGroup = OGRE_NEW TerrainGroup(mSceneMgr, Terrain::ALIGN_X_Z, mapSize, worldSize);
-    mTerrainGroup->setOrigin(Vector3::ZERO);
-    mTerrainGroup->setResourceGroup(m_sGroupName);
-
-    // Process terrain pages (*)
-    for (auto pPageElement : XMLNode.children("terrain"))
+#if OGRE_ENDIAN == OGRE_ENDIAN_BIG
+    for (auto& value : values)
     {
-        processTerrain(pPageElement);
+        uint32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        bits = Bitwise::bswap32(bits);
+        memcpy(&value, &bits, sizeof(bits));
     }
-    mTerrainGroup->loadAllTerrains(true);
+#endif
+
+    float* positions[] = {instances.px.data(), instances.py.data(), instances.pz.data()};
+    float* rotations[] = {instances.qw.data(), instances.qx.data(), instances.qy.data(), instances.qz.data()};
+    float* scales[] = {instances.sx.data(), instances.sy.data(), instances.sz.data()};
 
-    mTerrainGroup->freeTemporaryResources();
+    deinterleave(values.data(), count, positions, 3);
+    deinterleave(values.data() + count * 3, count, rotations, 4);
+    deinterleave(values.data() + count * 7, count, scales, 3);
+    return true;
 }
 
-void DotSceneLoader::processTerrain(pugi::xml_node& XMLNode)
+/// branch free, so the compiler can vectorise it. Zero length rotations become the identity
+void normaliseQuaternions(float* w, float* x, float* y, float* z, size_t count)
 {
-    String dataFile = getAttrib(XMLNode, "dataFile");
-    int pageX = StringConverter::parseInt(XMLNode.attribute("x").value());
-    int pageY = StringConverter::parseInt(XMLNode.attribute("y").value());
-
-    mTerrainGroup->defineTerrain(pageX, pageY, dataFile);
+    for (size_t i = 0; i < count; i++)
+    {
+        float squaredLength = w[i] * w[i] + x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+        float invalid = squaredLength > 0 ? 0.0f : 1.0f;
+        float scale = 1 / std::sqrt(squaredLength + invalid);
+
+        w[i] = w[i] * scale + invalid;
+        x[i] *= scale;
+        y[i] *= scale;
+        z[i] *= scale;
+    }
 }
 
-void DotSceneLoader::processLight(pugi::xml_node& XMLNode, SceneNode* pParent)
+/// derived transform of a node, tracked by the loader so it never has to ask Ogre to update the graph
+struct WorldTransform
 {
-    // Process attributes
-    String name = getAttrib(XMLNode, "name");
-    String id = getAttrib(XMLNode, "id");
+    Vector3 position;
+    Quaternion orientation;
+    Vector3 scale;
 
-    // Create the light
-    Light* pLight = mSceneMgr->createLight(name);
-    if (pParent)
-        pParent->attachObject(pLight);
-
-    String sValue = getAttrib(XMLNode, "type");
-    if (sValue == "point")
-        pLight->setType(Light::LT_POINT);
-    else if (sValue == "directional")
-        pLight->setType(Light::LT_DIRECTIONAL);
-    else if (sValue == "spot")
-        pLight->setType(Light::LT_SPOTLIGHT);
-    else if (sValue == "radPoint")
-        pLight->setType(Light::LT_POINT);
-
-    // lights are oriented using SceneNodes that expect -Z to be the default direction
-    // exporters should not write normal or direction if they attach lights to nodes
-    pLight->setDirection(Vector3::NEGATIVE_UNIT_Z);
-
-    pLight->setVisible(getAttribBool(XMLNode, "visible", true));
-    pLight->setCastShadows(getAttribBool(XMLNode, "castShadows", true));
-    pLight->setPowerScale(getAttribReal(XMLNode, "powerScale", 1.0));
+    /// same as Node::_updateFromParent with inherited orientation and scale
+    WorldTransform operator*(const WorldTransform& local) const
+    {
+        WorldTransform child;
+        child.orientation = orientation * local.orientation;
+        child.scale = scale * local.scale;
+        child.position = orientation * (scale * local.position) + position;
+        return child;
+    }
 
-    // Process colourDiffuse (?)
-    if (auto pElement = XMLNode.child("colourDiffuse"))
-        pLight->setDiffuseColour(parseColour(pElement));
+    WorldTransform operator*(const Node* node) const
+    {
+        return *this * WorldTransform{node->getPosition(), node->getOrientation(), node->getScale()};
+    }
+};
 
-    // Process colourSpecular (?)
-    if (auto pElement = XMLNode.child("colourSpecular"))
-        pLight->setSpecularColour(parseColour(pElement));
+const WorldTransform IDENTITY_TRANSFORM = {Vector3::ZERO, Quaternion::IDENTITY, Vector3::UNIT_SCALE};
 
-    if (sValue != "directional")
-    {
-        // Process lightRange (?)
-        if (auto pElement = XMLNode.child("lightRange"))
-            processLightRange(pElement, pLight);
+/// properties of a <userData> element by name, for LoadFilter::nodeUserData
+NameValuePairList getProperties(const pugi::xml_node& XMLNode)
+{
+    NameValuePairList properties;
+    for (auto pElement : XMLNode.children("property"))
+        properties[getAttrib(pElement, "name")] = getAttrib(pElement, "data");
+    return properties;
+}
 
-        // Process lightAttenuation (?)
-        if (auto pElement = XMLNode.child("lightAttenuation"))
-            processLightAttenuation(pElement, pLight);
-    }
-    // Process userDataReference (?)
-    if (auto pElement = XMLNode.child("userData"))
-        processUserData(pElement, pLight->getUserObjectBindings());
+/// whether filter loads a node, inSubtree tells if it is below one of filter.subtreeRoots
+bool acceptsNode(const DotSceneLoader::LoadFilter& filter, bool inSubtree, const String& name,
+                 const pugi::xml_node& userData)
+{
+    return (inSubtree || filter.subtreeRoots.empty()) && (!filter.nodeName || filter.nodeName(name)) &&
+           (!filter.nodeUserData || filter.nodeUserData(getProperties(userData)));
 }
 
-void DotSceneLoader::processCamera(pugi::xml_node& XMLNode, SceneNode* pParent)
+AxisAlignedBox transformBox(const AxisAlignedBox& box, const WorldTransform& xform)
 {
-    // Process attributes
-    String name = getAttrib(XMLNode, "name");
-    String id = getAttrib(XMLNode, "id");
-    // Real fov = getAttribReal(XMLNode, "fov", 45);
-    Real aspectRatio = getAttribReal(XMLNode, "aspectRatio", 1.3333);
-    String projectionType = getAttrib(XMLNode, "projectionType", "perspective");
+    if (!box.isFinite())
+        return box;
 
-    // Create the camera
-    Camera* pCamera = mSceneMgr->createCamera(name);
+    Matrix3 rot;
+    xform.orientation.ToRotationMatrix(rot);
 
-    // construct a scenenode is no parent
-    if (!pParent)
-        pParent = mAttachNode->createChildSceneNode(name);
+    Vector3 center = xform.position + xform.orientation * (xform.scale * box.getCenter());
+    Vector3 half = box.getHalfSize() *
+                   Vector3(Math::Abs(xform.scale.x), Math::Abs(xform.scale.y), Math::Abs(xform.scale.z));
 
-    pParent->attachObject(pCamera);
+    // extent of the rotated box along each world axis
+    Vector3 extent;
+    for (int i = 0; i < 3; i++)
+        extent[i] = Math::Abs(rot[i][0]) * half.x + Math::Abs(rot[i][1]) * half.y + Math::Abs(rot[i][2]) * half.z;
 
-    // Set the field-of-view
-    //! @todo Is this always in degrees?
-    // pCamera->setFOVy(Degree(fov));
+    return AxisAlignedBox(center - extent, center + extent);
+}
 
-    // Set the aspect ratio
-    pCamera->setAspectRatio(aspectRatio);
+struct MeshBounds
+{
+    bool read;
+    bool valid;
+    AxisAlignedBox bounds;
+    Real radius;
 
-    // Set the projection type
-    if (projectionType == "perspective")
-        pCamera->setProjectionType(PT_PERSPECTIVE);
-    else if (projectionType == "orthographic")
-        pCamera->setProjectionType(PT_ORTHOGRAPHIC);
+    MeshBounds() : read(false), valid(false), radius(0) {}
+};
 
-    // Process clipping (?)
-    if (auto pElement = XMLNode.child("clipping"))
-    {
-        Real nearDist = getAttribReal(pElement, "near");
-        pCamera->setNearClipDistance(nearDist);
+struct ResidencyState
+{
+    String name;
+    bool resident;
+};
 
-        Real farDist = getAttribReal(pElement, "far");
-        pCamera->setFarClipDistance(farDist);
+/// textures the material loads, along with whether they are resident already
+void collectTextures(const MaterialPtr& material, std::vector<ResidencyState>& textures)
+{
+    for (unsigned short t = 0; t < material->getNumTechniques(); t++)
+    {
+        Technique* technique = material->getTechnique(t);
+        for (unsigned short p = 0; p < technique->getNumPasses(); p++)
+        {
+            Pass* pass = technique->getPass(p);
+            for (unsigned short u = 0; u < pass->getNumTextureUnitStates(); u++)
+            {
+                TextureUnitState* tus = pass->getTextureUnitState(u);
+                for (unsigned int f = 0; f < tus->getNumFrames(); f++)
+                {
+                    const String& name = tus->getFrameTextureName(f);
+                    TexturePtr tex = TextureManager::getSingleton().getByName(name);
+                    textures.push_back({name, tex && tex->isLoaded()});
+                }
+            }
+        }
     }
-
-    // Process userDataReference (?)
-    if (auto pElement = XMLNode.child("userData"))
-        processUserData(pElement, static_cast<MovableObject*>(pCamera)->getUserObjectBindings());
 }
 
-void DotSceneLoader::processNode(pugi::xml_node& XMLNode, SceneNode* pParent)
+Any parseProperty(const DotSceneData::Property& property)
 {
-    // Construct the node's name
-    String name = m_sPrependNode + getAttrib(XMLNode, "name");
-
-    // Create the scene node
-    SceneNode* pNode;
-    if (name.empty())
-    {
-        // Let Ogre choose the name
-        if (pParent)
-            pNode = pParent->createChildSceneNode();
-        else
-            pNode = mAttachNode->createChildSceneNode();
-    }
+    if (property.type == "bool")
+        return Any(StringConverter::parseBool(property.data));
+    else if (property.type == "float")
+        return Any(StringConverter::parseReal(property.data));
+    else if (property.type == "int")
+        return Any(StringConverter::parseInt(property.data));
     else
+        return Any(property.data);
+}
+
+/// the userData property key as a number, 0 if there is none
+Real getPriority(const DotSceneData& data, const DotSceneData::UserData& userData, const String& key)
+{
+    for (uint32 i = userData.first; i < userData.first + userData.count; i++)
     {
-        // Provide the name
-        if (pParent)
-            pNode = pParent->createChildSceneNode(name);
-        else
-            pNode = mAttachNode->createChildSceneNode(name);
+        if (data.properties[i].name == key)
+            return StringConverter::parseReal(data.properties[i].data);
     }
+    return 0;
+}
+} // namespace
 
-    // Process other attributes
-    String id = getAttrib(XMLNode, "id");
-    // bool isTarget = getAttribBool(XMLNode, "isTarget"); // TODO: unused
+const String DotSceneLoader::PLANE_BINDING_KEY = "DotScenePlane";
 
-    // Process position (?)
-    if (auto pElement = XMLNode.child("position"))
+/** lets suspended particle systems emit once a camera comes close
+
+    The systems can outlive it, when the loader or the SceneManager record goes first, so it detaches from the
+    ones still suspended on destruction.
+*/
+struct DotSceneLoader::ParticleActivator : public MovableObject::Listener
+{
+    Real squaredDistance;
+    std::set<ParticleSystem*> suspended;
+
+    explicit ParticleActivator(Real distance) : squaredDistance(distance * distance) {}
+
+    ~ParticleActivator()
     {
-        pNode->setPosition(parseVector3(pElement));
-        pNode->setInitialState();
+        for (auto particles : suspended)
+            particles->setListener(0);
     }
 
-    // Process rotation (?)
-    if (auto pElement = XMLNode.child("rotation"))
+    void suspend(ParticleSystem* particles)
     {
-        pNode->setOrientation(parseQuaternion(pElement));
-        pNode->setInitialState();
+        particles->setEmitting(false);
+        particles->setListener(this);
+        suspended.insert(particles);
     }
 
-    // Process scale (?)
-    if (auto pElement = XMLNode.child("scale"))
+    bool objectRendering(const MovableObject* object, const Camera* camera)
     {
-        pNode->setScale(parseVector3(pElement));
-        pNode->setInitialState();
-    }
+        // only asked once the node passed culling, so its derived position is up to date
+        Real distance = object->getParentNode()->_getDerivedPosition().squaredDistance(camera->getDerivedPosition());
+        if (distance <= squaredDistance)
+        {
+            ParticleSystem* particles = const_cast<ParticleSystem*>(static_cast<const ParticleSystem*>(object));
+            particles->setEmitting(true);
+            particles->setListener(0);
+            suspended.erase(particles);
+        }
 
-    // Process lookTarget (?)
-    if (auto pElement = XMLNode.child("lookTarget"))
-        processLookTarget(pElement, pNode);
+        return true;
+    }
 
-    // Process trackTarget (?)
-    if (auto pElement = XMLNode.child("trackTarget"))
-        processTrackTarget(pElement, pNode);
+    void objectDestroyed(MovableObject* object) { suspended.erase(static_cast<ParticleSystem*>(object)); }
+};
 
-    // Process node (*)
-    for (auto pElement : XMLNode.children("node"))
+/// state of a single load, so one loader can serve concurrent loads
+struct DotSceneLoader::LoadContext
+{
+    SceneManager* sceneMgr;
+    SceneNode* attachNode;
+    String groupName;
+    String prependNode;
+
+    // copied from the loader, so they stay fixed for the duration of the load
+    size_t memoryBudget;
+    BudgetPolicy budgetPolicy;
+    String budgetPriorityKey;
+    LightImportMode lightImportMode;
+    bool buildBVH;
+    String cacheDirectory;
+    bool lazyEntities;
+    Real lazyDistance;
+    bool unnamedNodes;
+    Real particleSuspendDistance;
+    Vector3 particleReference;
+    LoadFilter filter;
+
+    /// the scene as parsed from XML or read from the cache
+    DotSceneData data;
+    /// indices into data.meshes while parsing
+    std::map<String, uint32> meshIndices;
+    /// false once the scene refers to data the cache key does not cover
+    bool cacheable;
+    /// while parsing, the transform of the nodes left out by the filter since the last node kept
+    WorldTransform skippedTransform;
+    /// while parsing, whether the current node is below one of filter.subtreeRoots
+    bool inSubtree;
+    bool skyPrefetched;
+
+    /// handles are only unique per ResourceManager, so the resources are keyed by address
+    std::set<const Resource*> accountedResources;
+    /// created nodes and their world transforms, by index into data.nodes
+    std::vector<SceneNode*> nodes;
+    std::vector<WorldTransform> transforms;
+    WorldTransform attachTransform;
+    /// by index into data.meshes, for placeholders
+    std::vector<MeshBounds> meshBounds;
+    /// whether each template name referred to exists, so an unknown one is only reported once
+    std::map<String, bool> particleTemplates;
+    std::unique_ptr<ParticleActivator> particleActivator;
+    LoadResult result;
+
+    LoadContext(const DotSceneLoader& loader, SceneNode* rootNode, const String& group, const String& prepend)
+        : sceneMgr(rootNode->getCreator()), attachNode(rootNode), groupName(group), prependNode(prepend),
+          memoryBudget(loader.mMemoryBudget), budgetPolicy(loader.mBudgetPolicy),
+          budgetPriorityKey(loader.mBudgetPriorityKey), lightImportMode(loader.mLightImportMode), buildBVH(loader.mBuildBVH),
+          cacheDirectory(loader.mCacheDirectory), lazyEntities(loader.mLazyEntities),
+          lazyDistance(loader.mLazyDistance), unnamedNodes(loader.mUnnamedNodes),
+          particleSuspendDistance(loader.mParticleSuspendDistance), particleReference(loader.mParticleReference),
+          cacheable(true),
+          skippedTransform(IDENTITY_TRANSFORM), inSubtree(false), skyPrefetched(false)
     {
-        processNode(pElement, pNode);
     }
 
-    // Process entity (*)
-    for (auto pElement : XMLNode.children("entity"))
+    /// index into data.meshes, every mesh is listed once however many entities use it
+    uint32 addMesh(const String& meshFile)
     {
-        processEntity(pElement, pNode);
+        auto inserted = meshIndices.insert(std::make_pair(meshFile, uint32(data.meshes.size())));
+        if (inserted.second)
+            data.meshes.push_back(meshFile);
+        return inserted.first->second;
     }
 
-    // Process light (*)
-    for (auto pElement : XMLNode.children("light"))
-    {
-        processLight(pElement, pNode);
-    }
+    SceneNode* getNode(int index) const { return index == DotSceneData::NO_NODE ? attachNode : nodes[index]; }
 
-    // Process camera (*)
-    for (auto pElement : XMLNode.children("camera"))
+    const WorldTransform& getTransform(int index) const
     {
-        processCamera(pElement, pNode);
+        return index == DotSceneData::NO_NODE ? attachTransform : transforms[index];
     }
 
-    // Process particleSystem (*)
-    for (auto pElement : XMLNode.children("particleSystem"))
+    /// world transform a node has right now, before the look targets of the nodes not yet done
+    WorldTransform getCurrentTransform(int index) const
     {
-        processParticleSystem(pElement, pNode);
+        // walk up to the first node whose world transform is known
+        std::vector<int> chain;
+        for (; index != DotSceneData::NO_NODE && index >= int(transforms.size()); index = data.nodes[index].parent)
+            chain.push_back(index);
+
+        WorldTransform xform = getTransform(index);
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+            xform = xform * nodes[*it];
+
+        return xform;
     }
+};
 
-    // Process billboardSet (*)
-    for (auto pElement : XMLNode.children("billboardSet"))
+DotSceneLoader::DotSceneLoader()
+    : mMemoryBudget(0), mBudgetPolicy(BP_DEFER), mLightImportMode(LIM_INDIVIDUAL), mBuildBVH(false),
+      mLazyEntities(false), mLazyDistance(0), mUnnamedNodes(false), mParticleSuspendDistance(0),
+      mParticleReference(Vector3::ZERO), mOwnsPlaceholderFactory(false), mLastResult(&mEmptyResult)
+{
+    StringVector extensions = {".scene"};
+#ifdef HAVE_ZSTD
+    extensions.push_back(".zst");
+#endif
+#ifdef HAVE_LZ4
+    extensions.push_back(".lz4");
+#endif
+    SceneLoaderManager::getSingleton().registerSceneLoader("DotScene", extensions, this);
+
+    if (!Root::getSingleton().hasMovableObjectFactory(DotScenePlaceholderFactory::FACTORY_TYPE_NAME))
     {
-        processBillboardSet(pElement, pNode);
+        Root::getSingleton().addMovableObjectFactory(&mPlaceholderFactory);
+        mOwnsPlaceholderFactory = true;
     }
+}
 
-    // Process plane (*)
-    for (auto pElement : XMLNode.children("plane"))
+DotSceneLoader::~DotSceneLoader()
+{
+    SceneLoaderManager::getSingleton().unregisterSceneLoader("DotScene");
+
+    for (auto& scene : mScenes)
     {
-        processPlane(pElement, pNode);
+        scene.first->removeListener(this);
+
+        // the placeholders would call back into this loader once they are found visible or destroyed
+        auto placeholders = scene.first->getMovableObjectIterator(DotScenePlaceholderFactory::FACTORY_TYPE_NAME);
+        while (placeholders.hasMoreElements())
+        {
+            auto placeholder = static_cast<DotScenePlaceholder*>(placeholders.getNext());
+            if (placeholder->getListener() == this)
+                placeholder->setListener(0);
+        }
+
+        // without the factory, the SceneManager could not destroy them later on
+        if (mOwnsPlaceholderFactory)
+            scene.first->destroyAllMovableObjectsByType(DotScenePlaceholderFactory::FACTORY_TYPE_NAME);
+
+        for (auto terrainGroup : scene.second.terrainGroups)
+            OGRE_DELETE terrainGroup;
     }
 
-    // Process userDataReference (?)
-    if (auto pElement = XMLNode.child("userData"))
-        processUserData(pElement, pNode->getUserObjectBindings());
+    if (mOwnsPlaceholderFactory)
+        Root::getSingleton().removeMovableObjectFactory(&mPlaceholderFactory);
 }
 
-void DotSceneLoader::processLookTarget(pugi::xml_node& XMLNode, SceneNode* pParent)
+void DotSceneLoader::parseDotScene(const String& SceneName, const String& groupName, SceneNode* pAttachNode,
+                                   const String& sPrependNode, const LoadFilter& filter)
 {
-    //! @todo Is this correct? Cause I don't have a clue actually
+    DataStreamPtr stream = Root::openFileStream(SceneName, groupName);
 
-    // Process attributes
-    String nodeName = getAttrib(XMLNode, "nodeName");
+    LoadContext ctx(*this, pAttachNode, groupName, sPrependNode);
+    ctx.filter = filter;
+    loadScene(ctx, stream);
+    publishResult(ctx);
+}
 
-    Node::TransformSpace relativeTo = Node::TS_PARENT;
-    String sValue = getAttrib(XMLNode, "relativeTo");
-    if (sValue == "local")
-        relativeTo = Node::TS_LOCAL;
-    else if (sValue == "parent")
-        relativeTo = Node::TS_PARENT;
+void DotSceneLoader::load(DataStreamPtr& stream, const String& groupName, SceneNode* rootNode)
+{
+    load(stream, groupName, rootNode, LoadFilter());
+}
+
+void DotSceneLoader::load(DataStreamPtr& stream, const String& groupName, SceneNode* rootNode,
+                          const LoadFilter& filter)
+{
+    LoadContext ctx(*this, rootNode, groupName, "");
+    ctx.filter = filter;
+    loadScene(ctx, stream);
+    publishResult(ctx);
+}
+
+DotSceneLoader::LoadResult DotSceneLoader::getResult(SceneManager* sceneMgr) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mScenes.find(sceneMgr);
+    return it == mScenes.end() ? mEmptyResult : it->second.lastResult;
+}
+
+void DotSceneLoader::sceneManagerDestroyed(SceneManager* source)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mScenes.find(source);
+    if (it == mScenes.end())
+        return;
+
+    for (auto terrainGroup : it->second.terrainGroups)
+        OGRE_DELETE terrainGroup;
+
+    if (mLastResult == &it->second.lastResult)
+        mLastResult = &mEmptyResult;
+
+    mScenes.erase(it);
+}
+
+void DotSceneLoader::preFindVisibleObjects(SceneManager* source, SceneManager::IlluminationRenderStage irs,
+                                           Viewport* v)
+{
+    std::vector<DotScenePlaceholder*> pending;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mScenes.find(source);
+        if (it == mScenes.end())
+            return;
+
+        pending.swap(it->second.pendingPlaceholders);
+    }
+
+    // outside of the search, the scene can be changed safely
+    for (auto placeholder : pending)
+    {
+        try
+        {
+            placeholder->materialise();
+            source->destroyMovableObject(placeholder);
+        }
+        catch (Exception& e)
+        {
+            LogManager::getSingleton().logError("[DotSceneLoader] Error materialising entity " +
+                                                placeholder->getName() + ": " + e.getDescription());
+        }
+    }
+}
+
+void DotSceneLoader::placeholderVisible(DotScenePlaceholder* placeholder)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mScenes.find(placeholder->_getManager());
+    if (it != mScenes.end())
+        it->second.pendingPlaceholders.push_back(placeholder);
+}
+
+void DotSceneLoader::placeholderDestroyed(DotScenePlaceholder* placeholder)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mScenes.find(placeholder->_getManager());
+    if (it == mScenes.end())
+        return;
+
+    auto& pending = it->second.pendingPlaceholders;
+    pending.erase(std::remove(pending.begin(), pending.end(), placeholder), pending.end());
+}
+
+void DotSceneLoader::publishResult(LoadContext& ctx)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mScenes.find(ctx.sceneMgr);
+    if (it == mScenes.end())
+    {
+        // results and terrain live as long as the SceneManager
+        it = mScenes.insert(std::make_pair(ctx.sceneMgr, SceneRecord())).first;
+        ctx.sceneMgr->addListener(this);
+    }
+
+    if (ctx.result.terrainGroup)
+        it->second.terrainGroups.push_back(ctx.result.terrainGroup);
+
+    // suspended particle systems refer to it until they resume
+    if (ctx.particleActivator)
+        it->second.particleActivators.push_back(std::move(ctx.particleActivator));
+
+    it->second.lastResult = std::move(ctx.result);
+    mLastResult = &it->second.lastResult;
+}
+
+void DotSceneLoader::loadScene(LoadContext& ctx, DataStreamPtr& stream)
+{
+    // a malformed scene must not throw out of a load, not even std::bad_alloc from a size taken from the file.
+    // Whatever was created up to here stays in the scene
+    try
+    {
+        if (!readScene(ctx, stream))
+            return;
+
+        // fail before creating anything, so there is nothing to clean up
+        if (ctx.memoryBudget && ctx.budgetPolicy == BP_FAIL)
+        {
+            size_t cost = estimateSceneCost(ctx);
+            if (cost > ctx.memoryBudget)
+            {
+                LogManager::getSingleton().stream(LML_CRITICAL)
+                    << "[DotSceneLoader] estimated " << cost << " bytes exceed the memory budget of "
+                    << ctx.memoryBudget << " bytes";
+                return;
+            }
+        }
+
+        createScene(ctx);
+
+        if (ctx.buildBVH)
+            ctx.result.bvh.build();
+    }
+    catch (std::exception& e)
+    {
+        LogManager::getSingleton().logError("[DotSceneLoader] Error loading " + stream->getName() + ": " + e.what());
+    }
+}
+
+bool DotSceneLoader::readScene(LoadContext& ctx, DataStreamPtr& stream)
+{
+    // the key does not cover the filter
+    if (ctx.cacheDirectory.empty() || !ctx.filter.isEmpty())
+        return parseScene(ctx, stream);
+
+    // the key covers the stream as stored, so a hit skips decompression as well
+    auto source = std::make_shared<MemoryDataStream>(stream);
+    uint64 key = DotSceneCache::computeKey(source->getPtr(), source->size());
+
+    DotSceneCache cache(ctx.cacheDirectory);
+    if (cache.load(key, ctx.data))
+    {
+        LogManager::getSingleton().logMessage("[DotSceneLoader] Using cached scene for " + stream->getName());
+        return true;
+    }
+
+    DataStreamPtr sourceStream = source;
+    if (!parseScene(ctx, sourceStream))
+        return false;
+
+    if (ctx.cacheable)
+        cache.save(key, ctx.data);
+    return true;
+}
+
+bool DotSceneLoader::parseScene(LoadContext& ctx, DataStreamPtr& stream)
+{
+    // the document is parsed in place, so the buffer has to outlive it
+    std::vector<char> buffer;
+    if (!readSceneStream(stream, buffer))
+        return false;
+
+    pugi::xml_document XMLDoc; // character type defaults to char
+
+    auto result = XMLDoc.load_buffer_inplace(buffer.data(), buffer.size());
+    if (!result)
+    {
+        LogManager::getSingleton().stream(LML_CRITICAL) << "[DotSceneLoader] " << result.description();
+        return false;
+    }
+
+    // Grab the scene node
+    auto XMLRoot = XMLDoc.child("scene");
+
+    // Validate the File
+    if (getAttrib(XMLRoot, "formatVersion", "") == "")
+    {
+        LogManager::getSingleton().logError("[DotSceneLoader] Invalid .scene File. Missing <scene>");
+        return false;
+    }
+
+    // Process the scene
+    processScene(ctx, XMLRoot);
+
+    resolveTargets(ctx);
+
+    return true;
+}
+
+void DotSceneLoader::processScene(LoadContext& ctx, pugi::xml_node& XMLRoot)
+{
+    // Process the scene parameters
+    String version = getAttrib(XMLRoot, "formatVersion", "unknown");
+
+    String message = "[DotSceneLoader] Parsing dotScene file with version " + version;
+    if (XMLRoot.attribute("ID"))
+        message += ", id " + String(XMLRoot.attribute("ID").value());
+    if (XMLRoot.attribute("sceneManager"))
+        message += ", scene manager " + String(XMLRoot.attribute("sceneManager").value());
+    if (XMLRoot.attribute("minOgreVersion"))
+        message += ", min. Ogre version " + String(XMLRoot.attribute("minOgreVersion").value());
+    if (XMLRoot.attribute("author"))
+        message += ", author " + String(XMLRoot.attribute("author").value());
+
+    LogManager::getSingleton().logMessage(message);
+
+    // Process environment (?)
+    if (auto pElement = XMLRoot.child("environment"))
+        processEnvironment(ctx, pElement);
+
+    // Process nodes (?)
+    if (auto pElement = XMLRoot.child("nodes"))
+        processNodes(ctx, pElement);
+
+    // Process externals (?)
+    if (auto pElement = XMLRoot.child("externals"))
+        processExternals(ctx, pElement);
+
+    // Process userDataReference (?)
+    if (auto pElement = XMLRoot.child("userData"))
+        ctx.data.userData = processUserData(ctx, pElement);
+
+    // only the subtrees are wanted then
+    if (ctx.filter.subtreeRoots.empty())
+    {
+        // Process light (?)
+        if (auto pElement = XMLRoot.child("light"))
+            processLight(ctx, pElement);
+
+        // Process camera (?)
+        if (auto pElement = XMLRoot.child("camera"))
+            processCamera(ctx, pElement);
+    }
+
+    // Process terrain (?)
+    if (auto pElement = XMLRoot.child("terrainGroup"))
+        processTerrainGroup(ctx, pElement);
+}
+
+void DotSceneLoader::processNodes(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    // Process position (?)
+    if (auto pElement = XMLNode.child("position"))
+    {
+        ctx.data.hasRootPosition = true;
+        ctx.data.rootPosition = parseVector3(pElement);
+    }
+
+    // Process rotation (?)
+    if (auto pElement = XMLNode.child("rotation"))
+    {
+        ctx.data.hasRootOrientation = true;
+        ctx.data.rootOrientation = parseQuaternion(pElement);
+    }
+
+    // Process scale (?)
+    if (auto pElement = XMLNode.child("scale"))
+    {
+        ctx.data.hasRootScale = true;
+        ctx.data.rootScale = parseVector3(pElement);
+    }
+
+    // Process node (*)
+    for (auto pElement : XMLNode.children("node"))
+    {
+        processNode(ctx, pElement);
+    }
+
+    // Process instances (*)
+    for (auto pElement : XMLNode.children("instances"))
+    {
+        processInstances(ctx, pElement, DotSceneData::NO_NODE);
+    }
+}
+
+void DotSceneLoader::processExternals(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    //! @todo Implement this
+}
+
+void DotSceneLoader::processEnvironment(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    if (!(ctx.filter.elements & LoadFilter::ET_ENVIRONMENT))
+        return;
+
+    DotSceneData::Environment& env = ctx.data.environment;
+
+    // Process camera (?)
+    if (auto pElement = XMLNode.child("camera"))
+        processCamera(ctx, pElement);
+
+    // Process fog (?)
+    if (auto pElement = XMLNode.child("fog"))
+        processFog(ctx, pElement);
+
+    // Process skyBox (?)
+    if (auto pElement = XMLNode.child("skyBox"))
+        processSkyBox(ctx, pElement);
+
+    // Process skyDome (?)
+    if (auto pElement = XMLNode.child("skyDome"))
+        processSkyDome(ctx, pElement);
+
+    // Process skyPlane (?)
+    if (auto pElement = XMLNode.child("skyPlane"))
+        processSkyPlane(ctx, pElement);
+
+    // Process colourAmbient (?)
+    if (auto pElement = XMLNode.child("colourAmbient"))
+    {
+        env.hasAmbient = true;
+        env.ambient = parseColour(pElement);
+    }
+
+    // Process colourBackground (?)
+    if (auto pElement = XMLNode.child("colourBackground"))
+    {
+        env.hasBackground = true;
+        env.background = parseColour(pElement);
+    }
+
+    // the sky textures load while the rest of the file is processed. A load that may still fail its budget must
+    // not load anything, so it prefetches once the estimate has passed
+    if (!ctx.memoryBudget || ctx.budgetPolicy != BP_FAIL)
+        prefetchSky(ctx);
+}
+
+void DotSceneLoader::processTerrainGroup(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    if (!(ctx.filter.elements & LoadFilter::ET_TERRAIN))
+        return;
+
+    DotSceneData::TerrainGroup& terrainGroup = ctx.data.terrainGroup;
+    ctx.data.hasTerrainGroup = true;
+
+    terrainGroup.worldSize = getAttribReal(XMLNode, "worldSize");
+    terrainGroup.mapSize = StringConverter::parseInt(XMLNode.attribute("size").value());
+
+    // Terrain only works with sizes of 2^n + 1
+    int mapSize = terrainGroup.mapSize;
+    if (mapSize < 3 || !Bitwise::isPO2(mapSize - 1) || terrainGroup.worldSize <= 0)
+    {
+        LogManager::getSingleton().logError("[DotSceneLoader] invalid terrainGroup size " +
+                                            StringConverter::toString(mapSize) + " or worldSize " +
+                                            StringConverter::toString(terrainGroup.worldSize));
+        ctx.data.hasTerrainGroup = false;
+        return;
+    }
+    // TODO: unused
+    // bool colourmapEnabled = getAttribBool(XMLNode, "colourmapEnabled");
+    // int colourMapTextureSize = StringConverter::parseInt(XMLNode.attribute("colourMapTextureSize").value());
+    terrainGroup.compositeMapDistance =
+        StringConverter::parseInt(XMLNode.attribute("tuningCompositeMapDistance").value());
+    terrainGroup.maxPixelError = StringConverter::parseInt(XMLNode.attribute("tuningMaxPixelError").value());
+
+    // Process terrain pages (*)
+    for (auto pPageElement : XMLNode.children("terrain"))
+    {
+        processTerrain(ctx, pPageElement);
+    }
+}
+
+void DotSceneLoader::processTerrain(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    DotSceneData::TerrainPage page;
+    page.dataFile = getAttrib(XMLNode, "dataFile");
+    page.x = StringConverter::parseInt(XMLNode.attribute("x").value());
+    page.y = StringConverter::parseInt(XMLNode.attribute("y").value());
+
+    ctx.data.terrainGroup.pages.push_back(page);
+}
+
+void DotSceneLoader::processLight(LoadContext& ctx, pugi::xml_node& XMLNode, int parent)
+{
+    if (!(ctx.filter.elements & LoadFilter::ET_LIGHT))
+        return;
+
+    DotSceneData::Light light;
+    light.node = parent;
+
+    // Process attributes
+    light.name = getAttrib(XMLNode, "name");
+    light.type = getAttrib(XMLNode, "type");
+    light.visible = getAttribBool(XMLNode, "visible", true);
+    light.castShadows = XMLNode.attribute("castShadows") ? getAttribBool(XMLNode, "castShadows") : -1;
+    light.powerScale = getAttribReal(XMLNode, "powerScale", 1.0);
+
+    // the defaults match the ones of Light
+    light.hasDiffuse = false;
+    light.diffuse = ColourValue::White;
+    light.hasSpecular = false;
+    light.specular = ColourValue::Black;
+    light.hasRange = false;
+    light.inner = Degree(30).valueRadians();
+    light.outer = Degree(40).valueRadians();
+    light.falloff = 1;
+    light.hasAttenuation = false;
+    light.range = 100000;
+    light.constant = 1;
+    light.linear = 0;
+    light.quadratic = 0;
+
+    // Process colourDiffuse (?)
+    if (auto pElement = XMLNode.child("colourDiffuse"))
+    {
+        light.hasDiffuse = true;
+        light.diffuse = parseColour(pElement);
+    }
+
+    // Process colourSpecular (?)
+    if (auto pElement = XMLNode.child("colourSpecular"))
+    {
+        light.hasSpecular = true;
+        light.specular = parseColour(pElement);
+    }
+
+    if (light.type != "directional")
+    {
+        // Process lightRange (?)
+        if (auto pElement = XMLNode.child("lightRange"))
+            processLightRange(pElement, light);
+
+        // Process lightAttenuation (?)
+        if (auto pElement = XMLNode.child("lightAttenuation"))
+            processLightAttenuation(pElement, light);
+    }
+    // Process userDataReference (?)
+    if (auto pElement = XMLNode.child("userData"))
+        light.userData = processUserData(ctx, pElement);
+
+    ctx.data.lights.push_back(light);
+}
+
+void DotSceneLoader::processCamera(LoadContext& ctx, pugi::xml_node& XMLNode, int parent)
+{
+    if (!(ctx.filter.elements & LoadFilter::ET_CAMERA))
+        return;
+
+    DotSceneData::Camera camera;
+    camera.node = parent;
+
+    // Process attributes
+    camera.name = getAttrib(XMLNode, "name");
+    // Real fov = getAttribReal(XMLNode, "fov", 45);
+    camera.aspectRatio = getAttribReal(XMLNode, "aspectRatio", 1.3333);
+    camera.projectionType = getAttrib(XMLNode, "projectionType", "perspective");
+
+    // Process clipping (?)
+    camera.hasClipping = false;
+    camera.nearDist = camera.farDist = 0;
+    if (auto pElement = XMLNode.child("clipping"))
+    {
+        camera.hasClipping = true;
+        camera.nearDist = getAttribReal(pElement, "near");
+        camera.farDist = getAttribReal(pElement, "far");
+    }
+
+    // Process userDataReference (?)
+    if (auto pElement = XMLNode.child("userData"))
+        camera.userData = processUserData(ctx, pElement);
+
+    ctx.data.cameras.push_back(camera);
+}
+
+void DotSceneLoader::processNode(LoadContext& ctx, pugi::xml_node& XMLNode, int parent)
+{
+    String name = getAttrib(XMLNode, "name");
+    WorldTransform local = IDENTITY_TRANSFORM;
+
+    // Process other attributes
+    // bool isTarget = getAttribBool(XMLNode, "isTarget"); // TODO: unused
+
+    // Process position (?)
+    if (auto pElement = XMLNode.child("position"))
+        local.position = parseVector3(pElement);
+
+    // Process rotation (?)
+    if (auto pElement = XMLNode.child("rotation"))
+        local.orientation = parseQuaternion(pElement);
+
+    // Process scale (?)
+    if (auto pElement = XMLNode.child("scale"))
+        local.scale = parseVector3(pElement);
+
+    const LoadFilter& filter = ctx.filter;
+    WorldTransform skippedTransform = ctx.skippedTransform;
+    bool inSubtree = ctx.inSubtree;
+
+    ctx.inSubtree = inSubtree || filter.subtreeRoots.empty() ||
+                    std::find(filter.subtreeRoots.begin(), filter.subtreeRoots.end(), name) !=
+                        filter.subtreeRoots.end();
+
+    bool selected = acceptsNode(filter, ctx.inSubtree, name, XMLNode.child("userData"));
+
+    // a node left out only passes its transform on to the nodes and instances below
+    if (!selected)
+    {
+        ctx.skippedTransform = skippedTransform * local;
+
+        // Process node (*)
+        for (auto pElement : XMLNode.children("node"))
+        {
+            processNode(ctx, pElement, parent);
+        }
+
+        // Process instances (*)
+        for (auto pElement : XMLNode.children("instances"))
+        {
+            processInstances(ctx, pElement, parent);
+        }
+
+        ctx.skippedTransform = skippedTransform;
+        ctx.inSubtree = inSubtree;
+        return;
+    }
+
+    local = skippedTransform * local;
+    ctx.skippedTransform = IDENTITY_TRANSFORM;
+
+    DotSceneData::Node node;
+    node.name = name;
+    node.parent = parent;
+    node.position = local.position;
+    node.orientation = local.orientation;
+    node.scale = local.scale;
+
+    // pre-order, so every parent precedes its children
+    int index = int(ctx.data.nodes.size());
+    ctx.data.nodes.push_back(node);
+
+    // Process lookTarget (?)
+    if (auto pElement = XMLNode.child("lookTarget"))
+        processLookTarget(ctx, pElement, index);
+
+    // Process trackTarget (?)
+    if (auto pElement = XMLNode.child("trackTarget"))
+        processTrackTarget(ctx, pElement, index);
+
+    // Process node (*)
+    for (auto pElement : XMLNode.children("node"))
+    {
+        processNode(ctx, pElement, index);
+    }
+
+    // Process instances (*)
+    for (auto pElement : XMLNode.children("instances"))
+    {
+        processInstances(ctx, pElement, index);
+    }
+
+    // Process entity (*)
+    for (auto pElement : XMLNode.children("entity"))
+    {
+        processEntity(ctx, pElement, index);
+    }
+
+    // Process light (*)
+    for (auto pElement : XMLNode.children("light"))
+    {
+        processLight(ctx, pElement, index);
+    }
+
+    // Process camera (*)
+    for (auto pElement : XMLNode.children("camera"))
+    {
+        processCamera(ctx, pElement, index);
+    }
+
+    // Process particleSystem (*)
+    for (auto pElement : XMLNode.children("particleSystem"))
+    {
+        processParticleSystem(ctx, pElement, index);
+    }
+
+    // Process billboardSet (*)
+    for (auto pElement : XMLNode.children("billboardSet"))
+    {
+        processBillboardSet(ctx, pElement, index);
+    }
+
+    // Process plane (*)
+    for (auto pElement : XMLNode.children("plane"))
+    {
+        processPlane(ctx, pElement, index);
+    }
+
+    // Process userDataReference (?)
+    if (auto pElement = XMLNode.child("userData"))
+        ctx.data.nodes[index].userData = processUserData(ctx, pElement);
+
+    ctx.skippedTransform = skippedTransform;
+    ctx.inSubtree = inSubtree;
+}
+
+void DotSceneLoader::processLookTarget(LoadContext& ctx, pugi::xml_node& XMLNode, int node)
+{
+    //! @todo Is this correct? Cause I don't have a clue actually
+
+    DotSceneData::LookTarget look;
+    look.node = node;
+    look.target = DotSceneData::NO_NODE;
+
+    // Process attributes
+    look.targetName = getAttrib(XMLNode, "nodeName");
+
+    look.relativeTo = Node::TS_PARENT;
+    String sValue = getAttrib(XMLNode, "relativeTo");
+    if (sValue == "local")
+        look.relativeTo = Node::TS_LOCAL;
+    else if (sValue == "parent")
+        look.relativeTo = Node::TS_PARENT;
     else if (sValue == "world")
-        relativeTo = Node::TS_WORLD;
+        look.relativeTo = Node::TS_WORLD;
+
+    // Process position (?)
+    look.position = Vector3::ZERO;
+    if (auto pElement = XMLNode.child("position"))
+        look.position = parseVector3(pElement);
+
+    // Process localDirection (?)
+    look.localDirection = Vector3::NEGATIVE_UNIT_Z;
+    if (auto pElement = XMLNode.child("localDirection"))
+        look.localDirection = parseVector3(pElement);
+
+    ctx.data.lookTargets.push_back(look);
+}
+
+void DotSceneLoader::processTrackTarget(LoadContext& ctx, pugi::xml_node& XMLNode, int node)
+{
+    DotSceneData::TrackTarget track;
+    track.node = node;
+    track.target = DotSceneData::NO_NODE;
+
+    // Process attributes
+    track.targetName = getAttrib(XMLNode, "nodeName");
+
+    // Process localDirection (?)
+    track.localDirection = Vector3::NEGATIVE_UNIT_Z;
+    if (auto pElement = XMLNode.child("localDirection"))
+        track.localDirection = parseVector3(pElement);
+
+    // Process offset (?)
+    track.offset = Vector3::ZERO;
+    if (auto pElement = XMLNode.child("offset"))
+        track.offset = parseVector3(pElement);
+
+    ctx.data.trackTargets.push_back(track);
+}
+
+void DotSceneLoader::processEntity(LoadContext& ctx, pugi::xml_node& XMLNode, int parent)
+{
+    if (!(ctx.filter.elements & LoadFilter::ET_ENTITY))
+        return;
+
+    DotSceneData::Entity entity;
+    entity.node = parent;
+
+    // Process attributes
+    entity.name = getAttrib(XMLNode, "name");
+    String meshFile = getAttrib(XMLNode, "meshFile");
+    entity.material = getAttrib(XMLNode, "material");
+    entity.castShadows = getAttribBool(XMLNode, "castShadows", true);
+
+    entity.mesh = ctx.addMesh(meshFile);
+
+    // Process userDataReference (?)
+    if (auto pElement = XMLNode.child("userData"))
+        entity.userData = processUserData(ctx, pElement);
+
+    ctx.data.entities.push_back(entity);
+}
+
+void DotSceneLoader::processInstances(LoadContext& ctx, pugi::xml_node& XMLNode, int parent)
+{
+    if (!(ctx.filter.elements & LoadFilter::ET_INSTANCES))
+        return;
+
+    // each instance is a node without name and userData, so the filter treats it like one
+    if (!acceptsNode(ctx.filter, ctx.inSubtree, String(), pugi::xml_node()))
+        return;
+
+    size_t count = StringConverter::parseUnsignedInt(getAttrib(XMLNode, "count"));
+    String meshFile = getAttrib(XMLNode, "meshFile");
+    String dataFile = getAttrib(XMLNode, "file");
+
+    InstanceArrays instances;
+
+    // Process data, either a binary file or one element per array
+    if (!dataFile.empty())
+    {
+        // the cache key only covers the scene file itself
+        ctx.cacheable = false;
+
+        try
+        {
+            DataStreamPtr stream = ResourceGroupManager::getSingleton().openResource(dataFile, ctx.groupName);
+            if (!readInstances(stream, count, instances))
+            {
+                LogManager::getSingleton().logError("[DotSceneLoader] " + dataFile + " does not hold " +
+                                                    StringConverter::toString(count) + " instances");
+                return;
+            }
+        }
+        catch (Exception& e)
+        {
+            LogManager::getSingleton().logError("[DotSceneLoader] Error reading instances: " + e.getDescription());
+            return;
+        }
+    }
+    else
+    {
+        // every value takes at least one character, so this bounds count before allocating for it
+        auto pPositions = XMLNode.child("positions");
+        if (!pPositions || std::strlen(pPositions.child_value()) < count * 3)
+        {
+            LogManager::getSingleton().logError("[DotSceneLoader] <instances> needs " +
+                                                StringConverter::toString(count) + " positions or a file");
+            return;
+        }
+
+        instances.resize(count);
+
+        // Process positions
+        float* positions[] = {instances.px.data(), instances.py.data(), instances.pz.data()};
+        // Process rotations (?)
+        float* rotations[] = {instances.qw.data(), instances.qx.data(), instances.qy.data(), instances.qz.data()};
+        // Process scales (?)
+        float* scales[] = {instances.sx.data(), instances.sy.data(), instances.sz.data()};
+
+        bool valid = parseInstanceArray(pPositions, count, positions, 3) &&
+                     parseInstanceArray(XMLNode.child("rotations"), count, rotations, 4) &&
+                     parseInstanceArray(XMLNode.child("scales"), count, scales, 3);
+        if (!valid)
+        {
+            LogManager::getSingleton().logError("[DotSceneLoader] <instances> arrays do not hold " +
+                                                StringConverter::toString(count) + " values each");
+            return;
+        }
+    }
+
+    normaliseQuaternions(instances.qw.data(), instances.qx.data(), instances.qy.data(), instances.qz.data(), count);
+
+    // every instance becomes a node of its own, with an entity if there is a mesh
+    DotSceneData::Entity entity = {};
+    if (!meshFile.empty())
+    {
+        entity.mesh = ctx.addMesh(meshFile);
+        entity.material = getAttrib(XMLNode, "material");
+        entity.castShadows = getAttribBool(XMLNode, "castShadows", true);
+    }
+
+    // no reserve: with many <instances> elements, reserving the exact size each time would defeat geometric growth
+
+    // below nodes left out by the filter
+    const WorldTransform& skipped = ctx.skippedTransform;
+    bool folded = skipped.position != Vector3::ZERO || skipped.orientation != Quaternion::IDENTITY ||
+                  skipped.scale != Vector3::UNIT_SCALE;
+
+    DotSceneData::Node node;
+    node.parent = parent;
+    for (size_t i = 0; i < count; i++)
+    {
+        WorldTransform local = {Vector3(instances.px[i], instances.py[i], instances.pz[i]),
+                                Quaternion(instances.qw[i], instances.qx[i], instances.qy[i], instances.qz[i]),
+                                Vector3(instances.sx[i], instances.sy[i], instances.sz[i])};
+        if (folded)
+            local = skipped * local;
+
+        node.position = local.position;
+        node.orientation = local.orientation;
+        node.scale = local.scale;
+
+        entity.node = int(ctx.data.nodes.size());
+        ctx.data.nodes.push_back(node);
+
+        if (!meshFile.empty())
+            ctx.data.entities.push_back(entity);
+    }
+}
+
+void DotSceneLoader::processParticleSystem(LoadContext& ctx, pugi::xml_node& XMLNode, int parent)
+{
+    if (!(ctx.filter.elements & LoadFilter::ET_PARTICLE_SYSTEM))
+        return;
+
+    DotSceneData::ParticleSystem particles;
+    particles.node = parent;
+
+    // Process attributes
+    particles.name = getAttrib(XMLNode, "name");
+    particles.templateName = getAttrib(XMLNode, "template");
+
+    if (particles.templateName.empty())
+        particles.templateName = getAttrib(XMLNode, "file"); // compatibility with old scenes
+
+    particles.quota = StringConverter::parseUnsignedInt(getAttrib(XMLNode, "quota"));
+
+    ctx.data.particleSystems.push_back(particles);
+}
+
+void DotSceneLoader::processBillboardSet(LoadContext& ctx, pugi::xml_node& XMLNode, int parent)
+{
+    //! @todo Implement this
+}
+
+void DotSceneLoader::processPlane(LoadContext& ctx, pugi::xml_node& XMLNode, int parent)
+{
+    if (!(ctx.filter.elements & LoadFilter::ET_PLANE))
+        return;
+
+    DotSceneData::Plane plane;
+    plane.node = parent;
+
+    plane.name = getAttrib(XMLNode, "name");
+    plane.distance = getAttribReal(XMLNode, "distance");
+    plane.width = getAttribReal(XMLNode, "width");
+    plane.height = getAttribReal(XMLNode, "height");
+    // MeshManager::createPlane divides by the segment counts, and the vertices must fit 16 bit indices
+    plane.xSegments = Math::Clamp(StringConverter::parseInt(getAttrib(XMLNode, "xSegments", "1")), 1,
+                                  MAX_PLANE_SEGMENTS);
+    plane.ySegments = Math::Clamp(StringConverter::parseInt(getAttrib(XMLNode, "ySegments", "1")), 1,
+                                  MAX_PLANE_SEGMENTS);
+    plane.numTexCoordSets = Math::Clamp(StringConverter::parseInt(getAttrib(XMLNode, "numTexCoordSets", "1")), 0,
+                                        OGRE_MAX_TEXTURE_COORD_SETS);
+    plane.uTile = getAttribReal(XMLNode, "uTile", 1);
+    plane.vTile = getAttribReal(XMLNode, "vTile", 1);
+    plane.material = getAttrib(XMLNode, "material");
+    plane.hasNormals = getAttribBool(XMLNode, "hasNormals");
+
+    // Process normal (?), a zero normal can not be turned into a plane
+    plane.normal = Vector3::UNIT_Y;
+    if (auto pElement = XMLNode.child("normal"))
+        plane.normal = parseVector3(pElement);
+
+    if (plane.normal.isZeroLength())
+    {
+        LogManager::getSingleton().logError("[DotSceneLoader] plane " + plane.name + " has a zero normal");
+        return;
+    }
+
+    // Process upVector (?)
+    plane.up = Vector3::UNIT_Z;
+    if (auto pElement = XMLNode.child("upVector"))
+        plane.up = parseVector3(pElement);
+
+    // the plane mesh can not be referenced by file, so keep the definition for DotSceneExporter
+    std::ostringstream definition;
+    XMLNode.print(definition);
+    plane.definition = definition.str();
+
+    ctx.data.planes.push_back(plane);
+}
+
+void DotSceneLoader::processFog(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    DotSceneData::Fog& fog = ctx.data.environment.fog;
+    ctx.data.environment.hasFog = true;
+
+    // Process attributes
+    fog.density = getAttribReal(XMLNode, "density", 0.001);
+    fog.start = getAttribReal(XMLNode, "start", 0.0);
+    fog.end = getAttribReal(XMLNode, "end", 1.0);
+
+    String sMode = getAttrib(XMLNode, "mode");
+    if (sMode == "none")
+        fog.mode = FOG_NONE;
+    else if (sMode == "exp")
+        fog.mode = FOG_EXP;
+    else if (sMode == "exp2")
+        fog.mode = FOG_EXP2;
+    else if (sMode == "linear")
+        fog.mode = FOG_LINEAR;
+    else
+        fog.mode = (FogMode)StringConverter::parseInt(sMode);
+
+    // Process colourDiffuse (?)
+    fog.colour = ColourValue::White;
+
+    if (auto pElement = XMLNode.child("colour"))
+        fog.colour = parseColour(pElement);
+}
+
+void DotSceneLoader::processSkyBox(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    DotSceneData::SkyBox& sky = ctx.data.environment.skyBox;
+
+    // Process attributes
+    sky.material = getAttrib(XMLNode, "material", "BaseWhite");
+    sky.distance = getAttribReal(XMLNode, "distance", 5000);
+    sky.drawFirst = getAttribBool(XMLNode, "drawFirst", true);
+    bool active = getAttribBool(XMLNode, "active", false);
+    if (!active)
+        return;
+
+    // Process rotation (?)
+    sky.rotation = Quaternion::IDENTITY;
+
+    if (auto pElement = XMLNode.child("rotation"))
+        sky.rotation = parseQuaternion(pElement);
+
+    ctx.data.environment.hasSkyBox = true;
+}
+
+void DotSceneLoader::processSkyDome(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    DotSceneData::SkyDome& sky = ctx.data.environment.skyDome;
+
+    // Process attributes
+    sky.material = XMLNode.attribute("material").value();
+    sky.curvature = getAttribReal(XMLNode, "curvature", 10);
+    sky.tiling = getAttribReal(XMLNode, "tiling", 8);
+    sky.distance = getAttribReal(XMLNode, "distance", 4000);
+    sky.drawFirst = getAttribBool(XMLNode, "drawFirst", true);
+    bool active = getAttribBool(XMLNode, "active", false);
+    if (!active)
+        return;
+
+    // Process rotation (?)
+    sky.rotation = Quaternion::IDENTITY;
+    if (auto pElement = XMLNode.child("rotation"))
+        sky.rotation = parseQuaternion(pElement);
+
+    ctx.data.environment.hasSkyDome = true;
+}
+
+void DotSceneLoader::processSkyPlane(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    DotSceneData::SkyPlane& sky = ctx.data.environment.skyPlane;
+    ctx.data.environment.hasSkyPlane = true;
+
+    // Process attributes
+    sky.material = getAttrib(XMLNode, "material");
+    Real planeX = getAttribReal(XMLNode, "planeX", 0);
+    Real planeY = getAttribReal(XMLNode, "planeY", -1);
+    Real planeZ = getAttribReal(XMLNode, "planeX", 0);
+    sky.normal = Vector3(planeX, planeY, planeZ);
+    sky.d = getAttribReal(XMLNode, "planeD", 5000);
+    sky.scale = getAttribReal(XMLNode, "scale", 1000);
+    sky.bow = getAttribReal(XMLNode, "bow", 0);
+    sky.tiling = getAttribReal(XMLNode, "tiling", 10);
+    sky.drawFirst = getAttribBool(XMLNode, "drawFirst", true);
+}
+
+void DotSceneLoader::processLightRange(pugi::xml_node& XMLNode, DotSceneData::Light& light)
+{
+    // Process attributes
+    light.hasRange = true;
+    light.inner = Radian(Angle(getAttribReal(XMLNode, "inner"))).valueRadians();
+    light.outer = Radian(Angle(getAttribReal(XMLNode, "outer"))).valueRadians();
+    light.falloff = getAttribReal(XMLNode, "falloff", 1.0);
+}
+
+void DotSceneLoader::processLightAttenuation(pugi::xml_node& XMLNode, DotSceneData::Light& light)
+{
+    // Process attributes
+    light.hasAttenuation = true;
+    light.range = getAttribReal(XMLNode, "range");
+    light.constant = getAttribReal(XMLNode, "constant");
+    light.linear = getAttribReal(XMLNode, "linear");
+    light.quadratic = getAttribReal(XMLNode, "quadratic");
+}
+
+DotSceneData::UserData DotSceneLoader::processUserData(LoadContext& ctx, pugi::xml_node& XMLNode)
+{
+    DotSceneData::UserData userData;
+    userData.first = uint32(ctx.data.properties.size());
+
+    // Process node (*)
+    for (auto pElement : XMLNode.children("property"))
+    {
+        DotSceneData::Property property;
+        property.name = getAttrib(pElement, "name");
+        property.type = getAttrib(pElement, "type");
+        property.data = getAttrib(pElement, "data");
+
+        ctx.data.properties.push_back(property);
+    }
+
+    userData.count = uint32(ctx.data.properties.size()) - userData.first;
+    return userData;
+}
+
+void DotSceneLoader::resolveTargets(LoadContext& ctx)
+{
+    // targets are named as in the file, regardless of the prefix of the load
+    std::map<String, int> indices;
+    for (int i = 0; i < int(ctx.data.nodes.size()); i++)
+    {
+        if (!ctx.data.nodes[i].name.empty())
+            indices.insert(std::make_pair(ctx.data.nodes[i].name, i));
+    }
+
+    for (auto& look : ctx.data.lookTargets)
+    {
+        auto it = indices.find(look.targetName);
+        if (it != indices.end())
+            look.target = it->second;
+    }
+
+    for (auto& track : ctx.data.trackTargets)
+    {
+        auto it = indices.find(track.targetName);
+        if (it != indices.end())
+            track.target = it->second;
+    }
+}
+
+void DotSceneLoader::createScene(LoadContext& ctx)
+{
+    const DotSceneData& data = ctx.data;
+
+    // for scenes from the cache, which were not parsed, and for loads that had to pass the budget first
+    prefetchSky(ctx);
+
+    createEnvironment(ctx);
+    createNodes(ctx);
+
+    // all nodes exist now, so a target may come later in the file
+    for (const auto& track : data.trackTargets)
+        createTrackTarget(ctx, track);
+
+    // the budget is spent in creation order, so the entities ranked highest come first
+    std::vector<std::pair<Real, const DotSceneData::Entity*>> entities;
+    entities.reserve(data.entities.size());
+    for (const auto& entity : data.entities)
+        entities.push_back(std::make_pair(0, &entity));
+
+    if (ctx.memoryBudget && !ctx.budgetPriorityKey.empty())
+    {
+        for (auto& entity : entities)
+            entity.first = getPriority(data, entity.second->userData, ctx.budgetPriorityKey);
+
+        std::stable_sort(entities.begin(), entities.end(),
+                         [](const std::pair<Real, const DotSceneData::Entity*>& a,
+                            const std::pair<Real, const DotSceneData::Entity*>& b) { return a.first > b.first; });
+    }
+
+    for (const auto& entity : entities)
+        createEntity(ctx, *entity.second);
+
+    for (const auto& light : data.lights)
+        createLight(ctx, light);
+
+    for (const auto& camera : data.cameras)
+        createCamera(ctx, camera);
+
+    for (const auto& particles : data.particleSystems)
+        createParticleSystem(ctx, particles);
+
+    for (const auto& plane : data.planes)
+        createPlane(ctx, plane);
+
+    for (size_t i = 0; i < data.nodes.size(); i++)
+        applyUserData(ctx, data.nodes[i].userData, ctx.nodes[i]->getUserObjectBindings());
+
+    applyUserData(ctx, data.userData, ctx.attachNode->getUserObjectBindings());
+
+    if (data.hasTerrainGroup)
+        createTerrainGroup(ctx);
+
+    // last, to give the prefetch as much time as possible
+    createSky(ctx);
+}
+
+void DotSceneLoader::createEnvironment(LoadContext& ctx)
+{
+    const DotSceneData::Environment& env = ctx.data.environment;
+
+    // Setup the fog
+    if (env.hasFog)
+        ctx.sceneMgr->setFog(env.fog.mode, env.fog.colour, env.fog.density, env.fog.start, env.fog.end);
 
-    // Process position (?)
-    Vector3 position;
-    if (auto pElement = XMLNode.child("position"))
-        position = parseVector3(pElement);
+    if (env.hasAmbient)
+        ctx.sceneMgr->setAmbientLight(env.ambient);
 
-    // Process localDirection (?)
-    Vector3 localDirection = Vector3::NEGATIVE_UNIT_Z;
-    if (auto pElement = XMLNode.child("localDirection"))
-        localDirection = parseVector3(pElement);
+    if (env.hasBackground)
+        ctx.result.backgroundColour = env.background;
+}
 
-    // Setup the look target
-    try
+void DotSceneLoader::prefetchSky(LoadContext& ctx)
+{
+    if (ctx.skyPrefetched)
+        return;
+
+    ctx.skyPrefetched = true;
+
+    const DotSceneData::Environment& env = ctx.data.environment;
+
+    StringVector materials;
+    if (env.hasSkyBox)
+        materials.push_back(env.skyBox.material);
+    if (env.hasSkyDome)
+        materials.push_back(env.skyDome.material);
+    if (env.hasSkyPlane)
+        materials.push_back(env.skyPlane.material);
+
+    // preparing a material prepares its textures, which reads and decodes the images off the main thread.
+    // Fog does not refer to any resources
+    for (const auto& name : materials)
+    {
+        MaterialPtr mat = MaterialManager::getSingleton().getByName(name, ctx.groupName);
+        if (!mat || mat->isLoaded() || mat->isPrepared())
+            continue;
+
+        ResourceBackgroundQueue::getSingleton().prepare(MaterialManager::getSingleton().getResourceType(), name,
+                                                        ctx.groupName);
+    }
+}
+
+void DotSceneLoader::createSky(LoadContext& ctx)
+{
+    const DotSceneData::Environment& env = ctx.data.environment;
+
+    // Setup the sky box
+    if (env.hasSkyBox)
+    {
+        const DotSceneData::SkyBox& sky = env.skyBox;
+        ctx.sceneMgr->setSkyBox(true, sky.material, sky.distance, sky.drawFirst, sky.rotation, ctx.groupName);
+    }
+
+    // Setup the sky dome
+    if (env.hasSkyDome)
+    {
+        const DotSceneData::SkyDome& sky = env.skyDome;
+        ctx.sceneMgr->setSkyDome(true, sky.material, sky.curvature, sky.tiling, sky.distance, sky.drawFirst,
+                                 sky.rotation, 16, 16, -1, ctx.groupName);
+    }
+
+    // Setup the sky plane
+    if (env.hasSkyPlane)
+    {
+        const DotSceneData::SkyPlane& sky = env.skyPlane;
+
+        Plane plane;
+        plane.normal = sky.normal;
+        plane.d = sky.d;
+        ctx.sceneMgr->setSkyPlane(true, plane, sky.material, sky.scale, sky.tiling, sky.drawFirst, sky.bow, 1, 1,
+                                  ctx.groupName);
+    }
+}
+
+void DotSceneLoader::createNodes(LoadContext& ctx)
+{
+    const DotSceneData& data = ctx.data;
+
+    // the root transform goes first, so the world transforms of the nodes below are final right away
+    if (data.hasRootPosition)
+    {
+        ctx.attachNode->setPosition(data.rootPosition);
+        ctx.attachNode->setInitialState();
+    }
+
+    if (data.hasRootOrientation)
+    {
+        ctx.attachNode->setOrientation(data.rootOrientation);
+        ctx.attachNode->setInitialState();
+    }
+
+    if (data.hasRootScale)
+    {
+        ctx.attachNode->setScale(data.rootScale);
+        ctx.attachNode->setInitialState();
+    }
+
+    // the only derived transform the loader asks Ogre for
+    ctx.attachTransform = {ctx.attachNode->_getDerivedPosition(), ctx.attachNode->_getDerivedOrientation(),
+                           ctx.attachNode->_getDerivedScale()};
+
+    size_t numNodes = data.nodes.size();
+    ctx.nodes.reserve(numNodes);
+    ctx.transforms.reserve(numNodes);
+
+    // children grouped by parent, slot 0 being the attach node and slot i + 1 node i.
+    // Parents precede their children, so the groups keep the order of the file
+    std::vector<uint32> firstChild(numNodes + 2, 0);
+    for (const auto& node : data.nodes)
+        firstChild[node.parent + 2]++;
+    for (size_t slot = 2; slot < firstChild.size(); slot++)
+        firstChild[slot] += firstChild[slot - 1];
+
+    std::vector<uint32> children(numNodes);
+    std::vector<uint32> next(firstChild.begin(), firstChild.end() - 1);
+    for (uint32 i = 0; i < numNodes; i++)
+        children[next[data.nodes[i].parent + 1]++] = i;
+
+    if (ctx.unnamedNodes)
+        ctx.result.nodes.reserve(numNodes);
+
+    // set up every node while it is detached, so its setters do not notify a parent
+    for (const auto& node : data.nodes)
     {
-        if (!nodeName.empty())
+        // Construct the node's name, unless the loader keeps it
+        String name = ctx.unnamedNodes ? String() : ctx.prependNode + node.name;
+
+        // Create the scene node, letting Ogre choose the name if there is none or it is taken
+        SceneNode* pNode = 0;
+        if (!name.empty())
         {
-            SceneNode* pLookNode = mSceneMgr->getSceneNode(nodeName);
-            position = pLookNode->_getDerivedPosition();
+            try
+            {
+                pNode = ctx.sceneMgr->createSceneNode(name);
+            }
+            catch (Exception& /*e*/)
+            {
+                LogManager::getSingleton().logWarning("[DotSceneLoader] duplicate node name " + name);
+            }
         }
 
-        pParent->lookAt(position, relativeTo, localDirection);
+        if (!pNode)
+            pNode = ctx.sceneMgr->createSceneNode();
+
+        // unprefixed, the name only has to be unique within this load
+        if (ctx.unnamedNodes && !node.name.empty())
+            ctx.result.nodes.insert(std::make_pair(node.name, pNode));
+
+        pNode->setPosition(node.position);
+        pNode->setOrientation(node.orientation);
+        pNode->setScale(node.scale);
+        pNode->setInitialState();
+
+        ctx.nodes.push_back(pNode);
     }
-    catch (Exception& /*e*/)
+
+    // attach all siblings in one go
+    for (int parent = DotSceneData::NO_NODE; parent < int(numNodes); parent++)
     {
-        LogManager::getSingleton().logMessage("[DotSceneLoader] Error processing a look target!");
+        uint32 first = firstChild[parent + 1];
+        uint32 last = firstChild[parent + 2];
+        if (first == last)
+            continue;
+
+        // flagged up front, the children do not queue an update request each
+        SceneNode* pParent = ctx.getNode(parent);
+        pParent->needUpdate();
+
+        for (uint32 i = first; i < last; i++)
+            pParent->addChild(ctx.nodes[children[i]]);
+    }
+
+    // look targets are stored in node order, and need the world transforms of the nodes before
+    auto look = data.lookTargets.begin();
+
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        for (; look != data.lookTargets.end() && look->node == int(i); ++look)
+            createLookTarget(ctx, *look);
+
+        ctx.transforms.push_back(ctx.getTransform(data.nodes[i].parent) * ctx.nodes[i]);
     }
 }
 
-void DotSceneLoader::processTrackTarget(pugi::xml_node& XMLNode, SceneNode* pParent)
+void DotSceneLoader::createLookTarget(LoadContext& ctx, const DotSceneData::LookTarget& look)
 {
-    // Process attributes
-    String nodeName = getAttrib(XMLNode, "nodeName");
+    // Setup the look target
+    try
+    {
+        Vector3 position = look.position;
+
+        // nodes further down in the file are in place, but not aimed yet
+        if (look.target != DotSceneData::NO_NODE)
+            position = ctx.getCurrentTransform(look.target).position;
+        else if (!look.targetName.empty())
+            position = ctx.sceneMgr->getSceneNode(look.targetName)->_getDerivedPosition();
+
+        // same as SceneNode::lookAt without fixed yaw, on the transforms of the loader
+        SceneNode* pNode = ctx.nodes[look.node];
+        const WorldTransform& parent = ctx.getTransform(ctx.data.nodes[look.node].parent);
+        WorldTransform world = parent * pNode;
+
+        // the direction to the target in world space
+        Vector3 direction;
+        switch (look.relativeTo)
+        {
+        case Node::TS_LOCAL:
+            direction = world.orientation * position;
+            break;
+        case Node::TS_PARENT:
+            direction = parent.orientation * (position - pNode->getPosition());
+            break;
+        default:
+            direction = position - world.position;
+            break;
+        }
 
-    pugi::xml_node pElement;
+        if (direction == Vector3::ZERO)
+            return;
 
-    // Process localDirection (?)
-    Vector3 localDirection = Vector3::NEGATIVE_UNIT_Z;
-    pElement = XMLNode.child("localDirection");
-    if (pElement)
-        localDirection = parseVector3(pElement);
+        direction.normalise();
 
-    // Process offset (?)
-    Vector3 offset = Vector3::ZERO;
-    if (auto pElement = XMLNode.child("offset"))
-        offset = parseVector3(pElement);
+        Quaternion orientation;
+        Vector3 currentDir = world.orientation * look.localDirection;
+        if ((currentDir + direction).squaredLength() < 0.00005f)
+        {
+            // a 180 degree turn, yaw around the current up
+            orientation = Quaternion(-world.orientation.y, -world.orientation.z, world.orientation.w,
+                                     world.orientation.x);
+        }
+        else
+            orientation = currentDir.getRotationTo(direction) * world.orientation;
+
+        pNode->setOrientation(parent.orientation.UnitInverse() * orientation);
+    }
+    catch (Exception& /*e*/)
+    {
+        LogManager::getSingleton().logMessage("[DotSceneLoader] Error processing a look target!");
+    }
+}
 
+void DotSceneLoader::createTrackTarget(LoadContext& ctx, const DotSceneData::TrackTarget& track)
+{
     // Setup the track target
     try
     {
-        SceneNode* pTrackNode = mSceneMgr->getSceneNode(nodeName);
-        pParent->setAutoTracking(true, pTrackNode, localDirection, offset);
+        SceneNode* pTrackNode = track.target != DotSceneData::NO_NODE ? ctx.nodes[track.target]
+                                                                      : ctx.sceneMgr->getSceneNode(track.targetName);
+        ctx.nodes[track.node]->setAutoTracking(true, pTrackNode, track.localDirection, track.offset);
     }
     catch (Exception& /*e*/)
     {
@@ -583,224 +2172,455 @@ void DotSceneLoader::processTrackTarget(pugi::xml_node& XMLNode, SceneNode* pPar
     }
 }
 
-void DotSceneLoader::processEntity(pugi::xml_node& XMLNode, SceneNode* pParent)
+void DotSceneLoader::createEntity(LoadContext& ctx, const DotSceneData::Entity& entity)
 {
-    // Process attributes
-    String name = getAttrib(XMLNode, "name");
-    String id = getAttrib(XMLNode, "id");
-    String meshFile = getAttrib(XMLNode, "meshFile");
-    String material = getAttrib(XMLNode, "material");
-    bool castShadows = getAttribBool(XMLNode, "castShadows", true);
+    if (ctx.lazyEntities && createPlaceholder(ctx, entity))
+        return;
+
+    SceneNode* pParent = ctx.nodes[entity.node];
+    const String& meshFile = ctx.data.meshes[entity.mesh];
 
     // Create the entity
-    Entity* pEntity = 0;
     try
     {
-        MeshManager::getSingleton().load(meshFile, m_sGroupName);
-        pEntity = mSceneMgr->createEntity(name, meshFile);
-        pEntity->setCastShadows(castShadows);
+        MeshPtr mesh = MeshManager::getSingleton().getByName(meshFile, ctx.groupName);
+        bool meshResident = mesh && mesh->isLoaded();
+
+        if (!meshResident && !fitsBudget(ctx, getResourceFileSize(meshFile, ctx.groupName)))
+        {
+            LogManager::getSingleton().logWarning("[DotSceneLoader] memory budget exceeded, deferring entity " +
+                                                  entity.name);
+            ctx.result.deferredEntities.push_back(
+                {entity.name, meshFile, entity.material, entity.castShadows, pParent});
+            return;
+        }
+
+        mesh = MeshManager::getSingleton().load(meshFile, ctx.groupName);
+        accountResource(ctx, mesh, ctx.result.memoryReport.meshes, meshResident);
+
+        // materials and textures get loaded along with the entity, so check their residency beforehand
+        StringVector materialNames;
+        for (unsigned short i = 0; i < mesh->getNumSubMeshes(); i++)
+            materialNames.push_back(mesh->getSubMesh(i)->getMaterialName());
+        if (!entity.material.empty())
+            materialNames.push_back(entity.material);
+
+        std::vector<ResidencyState> materials, textures;
+        for (const auto& materialName : materialNames)
+        {
+            MaterialPtr mat = MaterialManager::getSingleton().getByName(materialName);
+            if (!mat)
+                continue;
+
+            materials.push_back({materialName, mat->isLoaded()});
+            collectTextures(mat, textures);
+        }
+
+        Entity* pEntity = entity.name.empty() ? ctx.sceneMgr->createEntity(meshFile)
+                                              : ctx.sceneMgr->createEntity(entity.name, meshFile);
+
+        pEntity->setCastShadows(entity.castShadows);
         pParent->attachObject(pEntity);
 
-        if (!material.empty())
-            pEntity->setMaterialName(material);
+        if (!entity.material.empty())
+            pEntity->setMaterialName(entity.material);
+
+        addBounds(ctx, mesh->getBounds(), entity.node, pEntity);
+
+        for (const auto& state : materials)
+            accountResource(ctx, MaterialManager::getSingleton().getByName(state.name), ctx.result.memoryReport.materials,
+                            state.resident);
+        for (const auto& state : textures)
+            accountResource(ctx, TextureManager::getSingleton().getByName(state.name), ctx.result.memoryReport.textures,
+                            state.resident);
+
+        // Process userDataReference (?)
+        applyUserData(ctx, entity.userData, pEntity->getUserObjectBindings());
     }
     catch (Exception& /*e*/)
     {
         LogManager::getSingleton().logMessage("[DotSceneLoader] Error loading an entity!");
     }
+}
+
+bool DotSceneLoader::createPlaceholder(LoadContext& ctx, const DotSceneData::Entity& entity)
+{
+    const String& meshFile = ctx.data.meshes[entity.mesh];
+
+    // the bounds are read once per mesh
+    ctx.meshBounds.resize(ctx.data.meshes.size());
+    MeshBounds& mesh = ctx.meshBounds[entity.mesh];
+    if (!mesh.read)
+    {
+        mesh.read = true;
+
+        // a resident mesh knows its bounds already
+        MeshPtr resident = MeshManager::getSingleton().getByName(meshFile, ctx.groupName);
+        if (resident && resident->isLoaded())
+        {
+            mesh.bounds = resident->getBounds();
+            mesh.radius = resident->getBoundingSphereRadius();
+            mesh.valid = true;
+        }
+        else
+        {
+            mesh.valid = readMeshBounds(meshFile, ctx.groupName, mesh.bounds, mesh.radius);
+        }
+
+        if (!mesh.valid)
+            LogManager::getSingleton().logWarning("[DotSceneLoader] no bounds in " + meshFile +
+                                                  ", creating its entities right away");
+    }
+
+    if (!mesh.valid)
+        return false;
+
+    MovableObject* object =
+        entity.name.empty()
+            ? ctx.sceneMgr->createMovableObject(DotScenePlaceholderFactory::FACTORY_TYPE_NAME)
+            : ctx.sceneMgr->createMovableObject(entity.name, DotScenePlaceholderFactory::FACTORY_TYPE_NAME);
+
+    DotScenePlaceholder* placeholder = static_cast<DotScenePlaceholder*>(object);
+    placeholder->setEntity(meshFile, entity.material, mesh.bounds, mesh.radius);
+    placeholder->setCastShadows(entity.castShadows);
+    placeholder->setRenderingDistance(ctx.lazyDistance);
+    placeholder->setListener(this);
 
     // Process userDataReference (?)
-    if (auto pElement = XMLNode.child("userData"))
-        processUserData(pElement, pEntity->getUserObjectBindings());
+    for (uint32 i = entity.userData.first; i < entity.userData.first + entity.userData.count; i++)
+        placeholder->addUserAny(ctx.data.properties[i].name, parseProperty(ctx.data.properties[i]));
+
+    ctx.nodes[entity.node]->attachObject(placeholder);
+
+    addBounds(ctx, mesh.bounds, entity.node);
+
+    return true;
 }
 
-void DotSceneLoader::processParticleSystem(pugi::xml_node& XMLNode, SceneNode* pParent)
+void DotSceneLoader::createLight(LoadContext& ctx, const DotSceneData::Light& light)
 {
-    // Process attributes
-    String name = getAttrib(XMLNode, "name");
-    String id = getAttrib(XMLNode, "id");
-    String templateName = getAttrib(XMLNode, "template");
-
-    if (templateName.empty())
-        templateName = getAttrib(XMLNode, "file"); // compatibility with old scenes
+    // when packing, only explicit shadow casters need a Light of their own
+    bool packed = ctx.lightImportMode == LIM_PACKED;
+    if (packed && light.type != "directional" && light.castShadows != 1)
+    {
+        packLight(ctx, light);
+        return;
+    }
 
-    // Create the particle system
+    // Create the light
     try
     {
-        ParticleSystem* pParticles = mSceneMgr->createParticleSystem(name, templateName);
-        pParent->attachObject(pParticles);
+        Light* pLight = ctx.sceneMgr->createLight(light.name);
+
+        if (light.node != DotSceneData::NO_NODE)
+            ctx.nodes[light.node]->attachObject(pLight);
+
+        if (light.type == "point")
+            pLight->setType(Light::LT_POINT);
+        else if (light.type == "directional")
+            pLight->setType(Light::LT_DIRECTIONAL);
+        else if (light.type == "spot")
+            pLight->setType(Light::LT_SPOTLIGHT);
+        else if (light.type == "radPoint")
+            pLight->setType(Light::LT_POINT);
+
+        // lights are oriented using SceneNodes that expect -Z to be the default direction
+        // exporters should not write normal or direction if they attach lights to nodes
+        pLight->setDirection(Vector3::NEGATIVE_UNIT_Z);
+
+        pLight->setVisible(light.visible);
+        pLight->setCastShadows(light.castShadows < 0 ? !packed : light.castShadows == 1);
+        pLight->setPowerScale(light.powerScale);
+
+        if (light.hasDiffuse)
+            pLight->setDiffuseColour(light.diffuse);
+
+        if (light.hasSpecular)
+            pLight->setSpecularColour(light.specular);
+
+        // Setup the light range
+        if (light.hasRange)
+            pLight->setSpotlightRange(Radian(light.inner), Radian(light.outer), light.falloff);
+
+        // Setup the light attenuation
+        if (light.hasAttenuation)
+            pLight->setAttenuation(light.range, light.constant, light.linear, light.quadratic);
+
+        // Process userDataReference (?)
+        applyUserData(ctx, light.userData, pLight->getUserObjectBindings());
     }
     catch (Exception& /*e*/)
     {
-        LogManager::getSingleton().logMessage("[DotSceneLoader] Error creating a particle system!");
+        LogManager::getSingleton().logMessage("[DotSceneLoader] Error loading a light!");
     }
 }
 
-void DotSceneLoader::processBillboardSet(pugi::xml_node& XMLNode, SceneNode* pParent)
+void DotSceneLoader::packLight(LoadContext& ctx, const DotSceneData::Light& light)
 {
-    //! @todo Implement this
+    Light::LightTypes type = light.type == "spot" ? Light::LT_SPOTLIGHT : Light::LT_POINT;
+
+    // lights follow the -Z axis of their node
+    Vector3 position = Vector3::ZERO;
+    Vector3 direction = Vector3::NEGATIVE_UNIT_Z;
+    if (light.node != DotSceneData::NO_NODE)
+    {
+        const WorldTransform& xform = ctx.getTransform(light.node);
+        position = xform.position;
+        direction = xform.orientation * Vector3::NEGATIVE_UNIT_Z;
+    }
+
+    float visible = light.visible ? 1 : 0;
+    float powerScale = light.powerScale;
+
+    // unset values hold the defaults of Light
+    const ColourValue& diffuse = light.diffuse;
+    const ColourValue& specular = light.specular;
+
+    PackedLight packed = {{float(position.x), float(position.y), float(position.z), float(type)},
+                          {float(direction.x), float(direction.y), float(direction.z), float(light.range)},
+                          {diffuse.r, diffuse.g, diffuse.b, powerScale},
+                          {specular.r, specular.g, specular.b, visible},
+                          {float(light.constant), float(light.linear), float(light.quadratic), 0},
+                          {float(Math::Cos(light.inner * 0.5)), float(Math::Cos(light.outer * 0.5)),
+                           float(light.falloff), 0}};
+    ctx.result.packedLights.push_back(packed);
 }
 
-void DotSceneLoader::processPlane(pugi::xml_node& XMLNode, SceneNode* pParent)
+void DotSceneLoader::createCamera(LoadContext& ctx, const DotSceneData::Camera& camera)
 {
-    String name = getAttrib(XMLNode, "name");
-    Real distance = getAttribReal(XMLNode, "distance");
-    Real width = getAttribReal(XMLNode, "width");
-    Real height = getAttribReal(XMLNode, "height");
-    int xSegments = StringConverter::parseInt(getAttrib(XMLNode, "xSegments"));
-    int ySegments = StringConverter::parseInt(getAttrib(XMLNode, "ySegments"));
-    int numTexCoordSets = StringConverter::parseInt(getAttrib(XMLNode, "numTexCoordSets"));
-    Real uTile = getAttribReal(XMLNode, "uTile");
-    Real vTile = getAttribReal(XMLNode, "vTile");
-    String material = getAttrib(XMLNode, "material");
-    bool hasNormals = getAttribBool(XMLNode, "hasNormals");
-    Vector3 normal = parseVector3(XMLNode.child("normal"));
-    Vector3 up = parseVector3(XMLNode.child("upVector"));
+    // Create the camera
+    try
+    {
+        Camera* pCamera = ctx.sceneMgr->createCamera(camera.name);
 
-    Plane plane(normal, distance);
-    MeshPtr res =
-        MeshManager::getSingletonPtr()->createPlane(name + "mesh", m_sGroupName, plane, width, height, xSegments,
-                                                    ySegments, hasNormals, numTexCoordSets, uTile, vTile, up);
-    Entity* ent = mSceneMgr->createEntity(name, name + "mesh");
+        // construct a scenenode is no parent
+        SceneNode* pParent = camera.node == DotSceneData::NO_NODE
+                                 ? ctx.attachNode->createChildSceneNode(camera.name)
+                                 : ctx.nodes[camera.node];
 
-    ent->setMaterialName(material);
+        pParent->attachObject(pCamera);
 
-    pParent->attachObject(ent);
+        // Set the field-of-view
+        //! @todo Is this always in degrees?
+        // pCamera->setFOVy(Degree(fov));
+
+        // Set the aspect ratio
+        pCamera->setAspectRatio(camera.aspectRatio);
+
+        // Set the projection type
+        if (camera.projectionType == "perspective")
+            pCamera->setProjectionType(PT_PERSPECTIVE);
+        else if (camera.projectionType == "orthographic")
+            pCamera->setProjectionType(PT_ORTHOGRAPHIC);
+
+        if (camera.hasClipping)
+        {
+            pCamera->setNearClipDistance(camera.nearDist);
+            pCamera->setFarClipDistance(camera.farDist);
+        }
+
+        // Process userDataReference (?)
+        applyUserData(ctx, camera.userData, static_cast<MovableObject*>(pCamera)->getUserObjectBindings());
+    }
+    catch (Exception& /*e*/)
+    {
+        LogManager::getSingleton().logMessage("[DotSceneLoader] Error loading a camera!");
+    }
 }
 
-void DotSceneLoader::processFog(pugi::xml_node& XMLNode)
+void DotSceneLoader::createParticleSystem(LoadContext& ctx, const DotSceneData::ParticleSystem& particles)
 {
-    // Process attributes
-    Real expDensity = getAttribReal(XMLNode, "density", 0.001);
-    Real linearStart = getAttribReal(XMLNode, "start", 0.0);
-    Real linearEnd = getAttribReal(XMLNode, "end", 1.0);
+    // an unknown template is only reported once. Ogre still looks up and copies the template for every system
+    auto it = ctx.particleTemplates.find(particles.templateName);
+    if (it == ctx.particleTemplates.end())
+    {
+        bool known = ParticleSystemManager::getSingleton().getTemplate(particles.templateName) != 0;
+        if (!known)
+            LogManager::getSingleton().logError("[DotSceneLoader] unknown particle system template " +
+                                                particles.templateName);
 
-    FogMode mode = FOG_NONE;
-    String sMode = getAttrib(XMLNode, "mode");
-    if (sMode == "none")
-        mode = FOG_NONE;
-    else if (sMode == "exp")
-        mode = FOG_EXP;
-    else if (sMode == "exp2")
-        mode = FOG_EXP2;
-    else if (sMode == "linear")
-        mode = FOG_LINEAR;
-    else
-        mode = (FogMode)StringConverter::parseInt(sMode);
+        it = ctx.particleTemplates.insert(std::make_pair(particles.templateName, known)).first;
+    }
 
-    // Process colourDiffuse (?)
-    ColourValue colourDiffuse = ColourValue::White;
+    if (!it->second)
+        return;
 
-    if (auto pElement = XMLNode.child("colour"))
-        colourDiffuse = parseColour(pElement);
+    // Create the particle system
+    try
+    {
+        ParticleSystem* pParticles = ctx.sceneMgr->createParticleSystem(particles.name, particles.templateName);
 
-    // Setup the fog
-    mSceneMgr->setFog(mode, colourDiffuse, expDensity, linearStart, linearEnd);
+        // the pool is allocated on the first update, so the hint replaces the quota of the template before that
+        if (particles.quota)
+            pParticles->setParticleQuota(particles.quota);
+
+        Real suspendDistance = ctx.particleSuspendDistance;
+        if (suspendDistance > 0 && ctx.getTransform(particles.node).position.squaredDistance(ctx.particleReference) >
+                                       suspendDistance * suspendDistance)
+        {
+            if (!ctx.particleActivator)
+                ctx.particleActivator.reset(new ParticleActivator(suspendDistance));
+
+            ctx.particleActivator->suspend(pParticles);
+        }
+
+        ctx.nodes[particles.node]->attachObject(pParticles);
+    }
+    catch (Exception& /*e*/)
+    {
+        LogManager::getSingleton().logMessage("[DotSceneLoader] Error creating a particle system!");
+    }
 }
 
-void DotSceneLoader::processSkyBox(pugi::xml_node& XMLNode)
+void DotSceneLoader::createPlane(LoadContext& ctx, const DotSceneData::Plane& plane)
 {
-    // Process attributes
-    String material = getAttrib(XMLNode, "material", "BaseWhite");
-    Real distance = getAttribReal(XMLNode, "distance", 5000);
-    bool drawFirst = getAttribBool(XMLNode, "drawFirst", true);
-    bool active = getAttribBool(XMLNode, "active", false);
-    if (!active)
-        return;
+    // Create the plane
+    try
+    {
+        Plane surface(plane.normal, plane.distance);
+        String meshName = plane.name + "mesh" + StringConverter::toString(planeMeshCounter++);
+        MeshPtr res = MeshManager::getSingletonPtr()->createPlane(
+            meshName, ctx.groupName, surface, plane.width, plane.height, plane.xSegments, plane.ySegments,
+            plane.hasNormals, plane.numTexCoordSets, plane.uTile, plane.vTile, plane.up);
+        Entity* ent = ctx.sceneMgr->createEntity(plane.name, meshName);
 
-    // Process rotation (?)
-    Quaternion rotation = Quaternion::IDENTITY;
+        if (!plane.material.empty())
+            ent->setMaterialName(plane.material);
 
-    if (auto pElement = XMLNode.child("rotation"))
-        rotation = parseQuaternion(pElement);
+        // the plane mesh can not be referenced by file, so keep the definition for DotSceneExporter
+        ent->getUserObjectBindings().setUserAny(PLANE_BINDING_KEY, Any(plane.definition));
 
-    // Setup the sky box
-    mSceneMgr->setSkyBox(true, material, distance, drawFirst, rotation, m_sGroupName);
+        ctx.nodes[plane.node]->attachObject(ent);
+
+        addBounds(ctx, res->getBounds(), plane.node, ent);
+    }
+    catch (Exception& /*e*/)
+    {
+        LogManager::getSingleton().logMessage("[DotSceneLoader] Error loading a plane!");
+    }
 }
 
-void DotSceneLoader::processSkyDome(pugi::xml_node& XMLNode)
+void DotSceneLoader::createTerrainGroup(LoadContext& ctx)
 {
-    // Process attributes
-    String material = XMLNode.attribute("material").value();
-    Real curvature = getAttribReal(XMLNode, "curvature", 10);
-    Real tiling = getAttribReal(XMLNode, "tiling", 8);
-    Real distance = getAttribReal(XMLNode, "distance", 4000);
-    bool drawFirst = getAttribBool(XMLNode, "drawFirst", true);
-    bool active = getAttribBool(XMLNode, "active", false);
-    if (!active)
+    const DotSceneData::TerrainGroup& terrainGroup = ctx.data.terrainGroup;
+
+    auto terrainGlobalOptions = TerrainGlobalOptions::getSingletonPtr();
+    OgreAssert(terrainGlobalOptions, "TerrainGlobalOptions not available");
+
+    // the options are global, a concurrent load must not change them before the pages below are loaded
+    std::lock_guard<std::mutex> lock(terrainMutex);
+    terrainGlobalOptions->setMaxPixelError((Real)terrainGroup.maxPixelError);
+    terrainGlobalOptions->setCompositeMapDistance((Real)terrainGroup.compositeMapDistance);
+
+    ctx.result.terrainGroup =
+        OGRE_NEW TerrainGroup(ctx.sceneMgr, Terrain::ALIGN_X_Z, terrainGroup.mapSize, terrainGroup.worldSize);
+    ctx.result.terrainGroup->setOrigin(Vector3::ZERO);
+    ctx.result.terrainGroup->setResourceGroup(ctx.groupName);
+
+    // Process terrain pages (*)
+    for (const auto& page : terrainGroup.pages)
+    {
+        ctx.result.terrainGroup->defineTerrain(page.x, page.y, page.dataFile);
+    }
+
+    if (!fitsBudget(ctx, estimateTerrainCost(terrainGroup)))
+    {
+        LogManager::getSingleton().logWarning("[DotSceneLoader] memory budget exceeded, terrain pages are defined "
+                                              "but not loaded");
         return;
+    }
 
-    // Process rotation (?)
-    Quaternion rotation = Quaternion::IDENTITY;
-    if (auto pElement = XMLNode.child("rotation"))
-        rotation = parseQuaternion(pElement);
+    // a missing or broken page file must not abort the rest of the load
+    try
+    {
+        ctx.result.terrainGroup->loadAllTerrains(true);
+    }
+    catch (Exception& e)
+    {
+        LogManager::getSingleton().logError("[DotSceneLoader] Error loading terrain: " + e.getDescription());
+    }
 
-    // Setup the sky dome
-    mSceneMgr->setSkyDome(true, material, curvature, tiling, distance, drawFirst, rotation, 16, 16, -1, m_sGroupName);
+    ctx.result.terrainGroup->freeTemporaryResources();
+
+    accountTerrain(ctx);
+
+    auto ti = ctx.result.terrainGroup->getTerrainIterator();
+    while (ti.hasMoreElements())
+    {
+        if (Terrain* terrain = ti.getNext()->instance)
+            ctx.result.bounds.merge(terrain->getWorldAABB());
+    }
 }
 
-void DotSceneLoader::processSkyPlane(pugi::xml_node& XMLNode)
+void DotSceneLoader::applyUserData(LoadContext& ctx, const DotSceneData::UserData& userData,
+                                   UserObjectBindings& bindings)
 {
-    // Process attributes
-    String material = getAttrib(XMLNode, "material");
-    Real planeX = getAttribReal(XMLNode, "planeX", 0);
-    Real planeY = getAttribReal(XMLNode, "planeY", -1);
-    Real planeZ = getAttribReal(XMLNode, "planeX", 0);
-    Real planeD = getAttribReal(XMLNode, "planeD", 5000);
-    Real scale = getAttribReal(XMLNode, "scale", 1000);
-    Real bow = getAttribReal(XMLNode, "bow", 0);
-    Real tiling = getAttribReal(XMLNode, "tiling", 10);
-    bool drawFirst = getAttribBool(XMLNode, "drawFirst", true);
-
-    // Setup the sky plane
-    Plane plane;
-    plane.normal = Vector3(planeX, planeY, planeZ);
-    plane.d = planeD;
-    mSceneMgr->setSkyPlane(true, plane, material, scale, tiling, drawFirst, bow, 1, 1, m_sGroupName);
+    for (uint32 i = userData.first; i < userData.first + userData.count; i++)
+    {
+        const DotSceneData::Property& property = ctx.data.properties[i];
+        bindings.setUserAny(property.name, parseProperty(property));
+    }
 }
 
-void DotSceneLoader::processLightRange(pugi::xml_node& XMLNode, Light* pLight)
+size_t DotSceneLoader::estimateSceneCost(LoadContext& ctx)
 {
-    // Process attributes
-    Real inner = getAttribReal(XMLNode, "inner");
-    Real outer = getAttribReal(XMLNode, "outer");
-    Real falloff = getAttribReal(XMLNode, "falloff", 1.0);
+    size_t bytes = 0;
+
+    for (const auto& meshFile : ctx.data.meshes)
+    {
+        MeshPtr mesh = MeshManager::getSingleton().getByName(meshFile, ctx.groupName);
+        if (!mesh || !mesh->isLoaded())
+            bytes += getResourceFileSize(meshFile, ctx.groupName);
+    }
+
+    if (ctx.data.hasTerrainGroup)
+        bytes += estimateTerrainCost(ctx.data.terrainGroup);
 
-    // Setup the light range
-    pLight->setSpotlightRange(Angle(inner), Angle(outer), falloff);
+    return bytes;
 }
 
-void DotSceneLoader::processLightAttenuation(pugi::xml_node& XMLNode, Light* pLight)
+bool DotSceneLoader::fitsBudget(LoadContext& ctx, size_t bytes)
 {
-    // Process attributes
-    Real range = getAttribReal(XMLNode, "range");
-    Real constant = getAttribReal(XMLNode, "constant");
-    Real linear = getAttribReal(XMLNode, "linear");
-    Real quadratic = getAttribReal(XMLNode, "quadratic");
+    return ctx.memoryBudget == 0 || ctx.result.memoryReport.getUnique() + bytes <= ctx.memoryBudget;
+}
 
-    // Setup the light attenuation
-    pLight->setAttenuation(range, constant, linear, quadratic);
+void DotSceneLoader::accountResource(LoadContext& ctx, const ResourcePtr& res, MemoryUsage& usage, bool wasResident)
+{
+    // every resource is only counted once per load
+    if (!res || !ctx.accountedResources.insert(res.get()).second)
+        return;
+
+    if (wasResident)
+        usage.shared += res->getSize();
+    else
+        usage.unique += res->getSize();
 }
 
-void DotSceneLoader::processUserData(pugi::xml_node& XMLNode, UserObjectBindings& userData)
+void DotSceneLoader::accountTerrain(LoadContext& ctx)
 {
-    // Process node (*)
-    for (auto pElement : XMLNode.children("property"))
+    auto ti = ctx.result.terrainGroup->getTerrainIterator();
+    while (ti.hasMoreElements())
     {
-        String name = getAttrib(pElement, "name");
-        String type = getAttrib(pElement, "type");
-        String data = getAttrib(pElement, "data");
-
-        Any value;
-        if (type == "bool")
-            value = StringConverter::parseBool(data);
-        else if (type == "float")
-            value = StringConverter::parseReal(data);
-        else if (type == "int")
-            value = StringConverter::parseInt(data);
-        else
-            value = data;
-
-        userData.setUserAny(name, value);
+        Terrain* terrain = ti.getNext()->instance;
+        if (!terrain)
+            continue;
+
+        // height and delta data
+        ctx.result.memoryReport.terrain.unique += size_t(terrain->getSize()) * terrain->getSize() * sizeof(float) * 2;
+
+        accountResource(ctx, terrain->getTerrainNormalMap(), ctx.result.memoryReport.terrain, false);
+        accountResource(ctx, terrain->getLightmap(), ctx.result.memoryReport.terrain, false);
+        accountResource(ctx, terrain->getCompositeMap(), ctx.result.memoryReport.terrain, false);
+        for (uint8 i = 0; i < terrain->getBlendTextureCount(); i++)
+            accountResource(ctx, terrain->getLayerBlendTexture(i), ctx.result.memoryReport.terrain, false);
     }
 }
+
+void DotSceneLoader::addBounds(LoadContext& ctx, const AxisAlignedBox& bounds, int node, Entity* entity)
+{
+    AxisAlignedBox worldBounds = transformBox(bounds, ctx.getTransform(node));
+    ctx.result.bounds.merge(worldBounds);
+
+    if (ctx.buildBVH && entity)
+        ctx.result.bvh.add(worldBounds, entity);
+}
@@ -0,0 +1,81 @@
+#include "DotScenePlaceholder.h"
+
+#include <OgreEntity.h>
+#include <OgreSceneManager.h>
+#include <OgreSceneNode.h>
+
+using namespace Ogre;
+
+const String DotScenePlaceholderFactory::FACTORY_TYPE_NAME = "DotScenePlaceholder";
+
+DotScenePlaceholder::DotScenePlaceholder(const String& name)
+    : MovableObject(name), mRadius(0), mListener(0), mRequested(false)
+{
+}
+
+DotScenePlaceholder::~DotScenePlaceholder()
+{
+    if (mListener)
+        mListener->placeholderDestroyed(this);
+}
+
+void DotScenePlaceholder::setEntity(const String& meshFile, const String& material, const AxisAlignedBox& bounds,
+                                    Real radius)
+{
+    mMeshFile = meshFile;
+    mMaterial = material;
+    mBounds = bounds;
+    mRadius = radius;
+}
+
+void DotScenePlaceholder::addUserAny(const String& key, const Any& value)
+{
+    getUserObjectBindings().setUserAny(key, value);
+    mUserData.push_back(std::make_pair(key, value));
+}
+
+Entity* DotScenePlaceholder::materialise()
+{
+    Entity* entity = mManager->createEntity(mName, mMeshFile);
+    entity->setCastShadows(getCastShadows());
+
+    if (!mMaterial.empty())
+        entity->setMaterialName(mMaterial);
+
+    for (const auto& value : mUserData)
+        entity->getUserObjectBindings().setUserAny(value.first, value.second);
+
+    if (SceneNode* node = getParentSceneNode())
+    {
+        node->detachObject(this);
+        node->attachObject(entity);
+    }
+
+    return entity;
+}
+
+const String& DotScenePlaceholder::getMovableType() const
+{
+    return DotScenePlaceholderFactory::FACTORY_TYPE_NAME;
+}
+
+void DotScenePlaceholder::_updateRenderQueue(RenderQueue* queue)
+{
+    // only visible objects get here, nothing is queued for rendering
+    if (mRequested)
+        return;
+
+    mRequested = true;
+    if (mListener)
+        mListener->placeholderVisible(this);
+}
+
+MovableObject* DotScenePlaceholderFactory::createInstanceImpl(const String& name, const NameValuePairList* params)
+{
+    return OGRE_NEW DotScenePlaceholder(name);
+}
+
+void DotScenePlaceholderFactory::destroyInstance(MovableObject* obj)
+{
+    OGRE_DELETE obj;
+}
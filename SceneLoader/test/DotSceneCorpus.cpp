@@ -0,0 +1,133 @@
+#include "HeadlessRoot.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+
+using namespace Ogre;
+
+namespace
+{
+/// what a corpus scene must have produced, checked while its SceneManager still exists
+struct Expectation
+{
+    const char* file;
+    const char* description;
+    std::function<bool(SceneManager*, const DotSceneLoader::LoadResult&)> check;
+};
+
+bool hasIdentityOrientations(const Node* node)
+{
+    for (auto child : node->getChildren())
+    {
+        if (child->getOrientation() != Quaternion::IDENTITY || !hasIdentityOrientations(child))
+            return false;
+    }
+    return true;
+}
+
+const Expectation EXPECTATIONS[] = {
+    {"plane_missing_normal.scene", "the plane without a normal is created, the one with a zero normal is not",
+     [](SceneManager* sceneMgr, const DotSceneLoader::LoadResult&) {
+         return sceneMgr->hasEntity("noNormal") && !sceneMgr->hasEntity("zeroNormal");
+     }},
+    {"plane_segments.scene", "the segment counts are clamped to 255 and 1",
+     [](SceneManager* sceneMgr, const DotSceneLoader::LoadResult&) {
+         return sceneMgr->hasEntity("huge") &&
+                sceneMgr->getEntity("huge")->getMesh()->sharedVertexData->vertexCount == 256 * 2;
+     }},
+    {"zero_rotation.scene", "zero quaternions become identity orientations",
+     [](SceneManager* sceneMgr, const DotSceneLoader::LoadResult&) {
+         return sceneMgr->getRootSceneNode()->numChildren() == 3 &&
+                hasIdentityOrientations(sceneMgr->getRootSceneNode());
+     }},
+    {"terrain_bad_size.scene", "no terrain group for a size that is not 2^n + 1",
+     [](SceneManager*, const DotSceneLoader::LoadResult& result) { return result.terrainGroup == 0; }},
+    {"terrain_zero_world.scene", "no terrain group for a world size of 0",
+     [](SceneManager*, const DotSceneLoader::LoadResult& result) { return result.terrainGroup == 0; }},
+    {"instances_count.scene", "instances with fewer positions than their count are rejected",
+     [](SceneManager* sceneMgr, const DotSceneLoader::LoadResult&) {
+         return sceneMgr->getRootSceneNode()->numChildren() == 0;
+     }},
+};
+} // namespace
+
+/** loads every .scene file in a directory, checks the expectations on the known ones and reports the throughput
+    An optional minimum throughput in MB/s makes the run fail if it is not reached */
+int main(int argc, char* argv[])
+{
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "usage: " << argv[0] << " corpusDirectory [minMBps]" << std::endl;
+        return 1;
+    }
+
+    double minThroughput = argc == 3 ? std::atof(argv[2]) : 0;
+
+    HeadlessRoot root(false);
+
+    ResourceGroupManager& resourceGroups = ResourceGroupManager::getSingleton();
+    resourceGroups.addResourceLocation(argv[1], "FileSystem", "Corpus");
+
+    StringVectorPtr files = resourceGroups.findResourceNames("Corpus", "*.scene");
+    if (files->empty())
+    {
+        std::cout << "no .scene files in " << argv[1] << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    size_t checked = 0;
+    size_t bytes = 0;
+    std::chrono::duration<double> elapsed(0);
+    for (const auto& file : *files)
+    {
+        // read up front, so the file system is not timed
+        DataStreamPtr source = resourceGroups.openResource(file, "Corpus");
+        DataStreamPtr stream = std::make_shared<MemoryDataStream>(source);
+        bytes += stream->size();
+
+        SceneManager* sceneMgr = root.createSceneManager();
+
+        auto start = std::chrono::steady_clock::now();
+        root.load(stream, sceneMgr);
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        for (const auto& expectation : EXPECTATIONS)
+        {
+            if (file != expectation.file)
+                continue;
+
+            checked++;
+            if (!expectation.check(sceneMgr, root.getLoader().getResult(sceneMgr)))
+            {
+                std::cout << "FAIL " << file << ": " << expectation.description << std::endl;
+                failures++;
+            }
+        }
+
+        root.destroySceneManager(sceneMgr);
+    }
+
+    // a renamed or missing corpus file must not pass silently
+    size_t numExpectations = sizeof(EXPECTATIONS) / sizeof(EXPECTATIONS[0]);
+    if (checked != numExpectations)
+    {
+        std::cout << "FAIL only " << checked << " of " << numExpectations << " expected scenes found" << std::endl;
+        failures++;
+    }
+
+    double throughput = bytes / elapsed.count() / (1024 * 1024);
+    std::cout << files->size() << " scenes, " << bytes << " bytes in " << elapsed.count() << " s, " << throughput
+              << " MB/s" << std::endl;
+
+    if (throughput < minThroughput)
+    {
+        std::cout << "FAIL throughput below " << minThroughput << " MB/s" << std::endl;
+        failures++;
+    }
+
+    return failures ? 1 : 0;
+}
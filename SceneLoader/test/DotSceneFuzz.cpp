@@ -0,0 +1,16 @@
+#include "HeadlessRoot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// libFuzzer entry point, every input is loaded as a .scene stream
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static HeadlessRoot root(true);
+
+    Ogre::DataStreamPtr stream =
+        std::make_shared<Ogre::MemoryDataStream>("fuzz.scene", const_cast<uint8_t*>(data), size, false, true);
+    root.load(stream);
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "HeadlessRoot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <sstream>
+
+using namespace Ogre;
+
+namespace
+{
+/// a flat scene of count sibling nodes, the worst case for creating and attaching nodes one by one
+String generateFlatScene(int count)
+{
+    std::ostringstream scene;
+    scene.imbue(std::locale::classic());
+
+    scene << "<scene formatVersion=\"1.1\">\n<nodes>\n";
+    for (int i = 0; i < count; i++)
+        scene << "<node name=\"n" << i << "\"><position x=\"" << i % 1000 << "\" y=\"0\" z=\"" << i / 1000
+              << "\"/></node>\n";
+    scene << "</nodes>\n</scene>\n";
+    return scene.str();
+}
+} // namespace
+
+// times loads of a generated flat scene, so node creation can be compared between builds
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+    if (count <= 0 || runs <= 0)
+    {
+        std::cout << "usage: " << argv[0] << " [nodeCount] [runs]" << std::endl;
+        return 1;
+    }
+
+    HeadlessRoot root(true);
+    String scene = generateFlatScene(count);
+
+    // the fastest run, the others are disturbed by the allocator or the system
+    std::chrono::duration<double> best(0);
+    for (int i = 0; i < runs; i++)
+    {
+        DataStreamPtr stream =
+            std::make_shared<MemoryDataStream>(const_cast<char*>(scene.data()), scene.size(), false, true);
+        SceneManager* sceneMgr = root.createSceneManager();
+
+        auto start = std::chrono::steady_clock::now();
+        root.load(stream, sceneMgr);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (sceneMgr->getRootSceneNode()->numChildren() != size_t(count))
+        {
+            std::cout << "expected " << count << " nodes, got " << sceneMgr->getRootSceneNode()->numChildren()
+                      << std::endl;
+            return 1;
+        }
+
+        root.destroySceneManager(sceneMgr);
+        best = i == 0 ? elapsed : std::min(best, elapsed);
+    }
+
+    std::cout << count << " nodes in " << best.count() * 1000 << " ms, " << count / best.count() << " nodes/s"
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef DOT_SCENEHEADLESSROOT_H
+#define DOT_SCENEHEADLESSROOT_H
+
+#include <Ogre.h>
+#include <OgreDefaultHardwareBufferManager.h>
+#include <OgreTerrain.h>
+
+#include "DotSceneLoader.h"
+
+/** Root without a render system, for loading scenes in tests
+
+    Buffers live in system memory, so manual meshes like planes can be created. Mesh files and textures are not
+    available, so entities referring to them fail to be created.
+*/
+class HeadlessRoot
+{
+public:
+    explicit HeadlessRoot(bool quiet) : mLogManager(new Ogre::LogManager)
+    {
+        // the default log would write a file and echo every message
+        mLogManager->createLog("DotSceneTest.log", true, !quiet, true);
+
+        mRoot = new Ogre::Root("", "", "");
+        mBufferManager = new Ogre::DefaultHardwareBufferManager;
+        Ogre::MaterialManager::getSingleton().initialise();
+        mTerrainOptions = OGRE_NEW Ogre::TerrainGlobalOptions;
+
+        mLoader = new DotSceneLoader;
+    }
+
+    ~HeadlessRoot()
+    {
+        delete mLoader;
+        OGRE_DELETE mTerrainOptions;
+        // the meshes the scenes created are only freed with Root, and that needs the buffer manager
+        delete mRoot;
+        delete mBufferManager;
+        delete mLogManager;
+    }
+
+    DotSceneLoader& getLoader() { return *mLoader; }
+
+    Ogre::SceneManager* createSceneManager() { return mRoot->createSceneManager("DefaultSceneManager"); }
+    void destroySceneManager(Ogre::SceneManager* sceneMgr) { mRoot->destroySceneManager(sceneMgr); }
+
+    void load(Ogre::DataStreamPtr& stream, Ogre::SceneManager* sceneMgr)
+    {
+        mLoader->load(stream, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, sceneMgr->getRootSceneNode());
+    }
+
+    /// load stream into a new SceneManager, which is destroyed afterwards
+    void load(Ogre::DataStreamPtr& stream)
+    {
+        Ogre::SceneManager* sceneMgr = createSceneManager();
+        load(stream, sceneMgr);
+        destroySceneManager(sceneMgr);
+    }
+
+private:
+    Ogre::LogManager* mLogManager;
+    Ogre::Root* mRoot;
+    Ogre::DefaultHardwareBufferManager* mBufferManager;
+    Ogre::TerrainGlobalOptions* mTerrainOptions;
+    DotSceneLoader* mLoader;
+};
+
+#endif // DOT_SCENEHEADLESSROOT_H